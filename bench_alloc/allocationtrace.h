@@ -0,0 +1,300 @@
+/**
+ *
+ * Copyright (C) 2015 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com, author Milian Wolff <milian.wolff@kdab.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef BENCH_QT_ALLOCATIONTRACE_H
+#define BENCH_QT_ALLOCATIONTRACE_H
+
+#include <QDataStream>
+#include <QFile>
+#include <QString>
+#include <QTextStream>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <utility>
+#include <vector>
+
+/**
+ * A recorded or generated sequence of allocations, which can be replayed
+ * against any of the allocators in allocators.h.
+ *
+ * Each event allocates @c size bytes on thread @c thread. The allocation is
+ * freed again on the same thread after @c lifetime further allocations of
+ * that thread, i.e. a lifetime of zero frees it right away. Allocations
+ * whose lifetime extends beyond the end of the trace are freed at the end.
+ *
+ * Two file formats are supported:
+ *
+ * - text: one event per line as "<size> <lifetime> <thread>",
+ *   empty lines and lines starting with '#' are ignored
+ * - binary: the magic "BQAT", followed by a QDataStream of a quint32 event
+ *   count and for every event a quint32 size, quint32 lifetime and quint16
+ *   thread, i.e. ten bytes per event
+ */
+struct AllocationEvent
+{
+    quint32 size;
+    quint32 lifetime;
+    quint16 thread;
+};
+
+class AllocationTrace
+{
+public:
+    bool load(const QString& path)
+    {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            qWarning("failed to open allocation trace %s: %s", qPrintable(path), qPrintable(file.errorString()));
+            return false;
+        }
+        m_events.clear();
+        if (!(file.peek(magic().size()) == magic() ? loadBinary(&file) : loadText(&file))) {
+            qWarning("failed to parse allocation trace %s", qPrintable(path));
+            return false;
+        }
+        if (m_events.empty()) {
+            qWarning("allocation trace %s contains no allocations", qPrintable(path));
+            return false;
+        }
+        return true;
+    }
+
+    void append(const AllocationEvent& event)
+    {
+        m_events.push_back(event);
+    }
+
+    const std::vector<AllocationEvent>& events() const
+    {
+        return m_events;
+    }
+
+    int numThreads() const
+    {
+        quint16 maxThread = 0;
+        for (const auto& event : m_events) {
+            maxThread = std::max(maxThread, event.thread);
+        }
+        return m_events.empty() ? 0 : maxThread + 1;
+    }
+
+    // the maximum number of bytes alive at the same time on any one thread
+    quint64 peakLiveBytes(int thread) const
+    {
+        // +size at the allocation step, -size at the step after its last use
+        std::vector<std::pair<quint64, qint64>> deltas;
+        quint64 step = 0;
+        for (const auto& event : m_events) {
+            if (event.thread != thread) {
+                continue;
+            }
+            deltas.emplace_back(step, event.size);
+            deltas.emplace_back(step + event.lifetime + 1, -static_cast<qint64>(event.size));
+            ++step;
+        }
+        std::sort(deltas.begin(), deltas.end());
+        qint64 live = 0;
+        qint64 peak = 0;
+        for (const auto& delta : deltas) {
+            live += delta.second;
+            peak = std::max(peak, live);
+        }
+        return static_cast<quint64>(peak);
+    }
+
+private:
+    bool loadText(QFile* file)
+    {
+        QTextStream stream(file);
+        QString line;
+        while (stream.readLineInto(&line)) {
+            line = line.trimmed();
+            if (line.isEmpty() || line.startsWith(QLatin1Char('#'))) {
+                continue;
+            }
+            const auto fields = line.splitRef(QLatin1Char(' '), QString::SkipEmptyParts);
+            if (fields.size() != 3) {
+                return false;
+            }
+            bool sizeOk = false;
+            bool lifetimeOk = false;
+            bool threadOk = false;
+            append({fields[0].toUInt(&sizeOk), fields[1].toUInt(&lifetimeOk), fields[2].toUShort(&threadOk)});
+            if (!sizeOk || !lifetimeOk || !threadOk) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool loadBinary(QFile* file)
+    {
+        file->read(magic().size());
+        QDataStream stream(file);
+        quint32 count = 0;
+        stream >> count;
+        // don't trust the count before allocating for it
+        if (stream.status() != QDataStream::Ok || static_cast<qint64>(count) > (file->size() - file->pos()) / EVENT_SIZE) {
+            return false;
+        }
+        m_events.resize(count);
+        for (auto& event : m_events) {
+            stream >> event.size >> event.lifetime >> event.thread;
+        }
+        return stream.status() == QDataStream::Ok;
+    }
+
+    // the size of an event in the binary format
+    static const qint64 EVENT_SIZE = sizeof(quint32) + sizeof(quint32) + sizeof(quint16);
+
+    static QByteArray magic()
+    {
+        return QByteArrayLiteral("BQAT");
+    }
+
+    std::vector<AllocationEvent> m_events;
+};
+
+/**
+ * Generate a trace of @p eventsPerThread allocations for each of @p numThreads
+ * threads, with sizes drawn from @p sizeDistribution.
+ *
+ * Most allocations die young, with an exponentially distributed lifetime.
+ * A small fraction lives much longer, which is what fragments the heap.
+ */
+template<typename SizeDistribution>
+AllocationTrace generateTrace(size_t eventsPerThread, int numThreads, SizeDistribution sizeDistribution)
+{
+    AllocationTrace trace;
+    for (int thread = 0; thread < numThreads; ++thread) {
+        std::mt19937 generator(thread);
+        std::exponential_distribution<double> shortLifetime(1. / 16);
+        std::uniform_int_distribution<quint32> longLifetime(eventsPerThread / 100, eventsPerThread);
+        std::bernoulli_distribution isLongLived(0.05);
+        for (size_t i = 0; i < eventsPerThread; ++i) {
+            const quint32 size = sizeDistribution(generator);
+            const quint32 lifetime = isLongLived(generator) ? longLifetime(generator)
+                                                            : static_cast<quint32>(shortLifetime(generator));
+            trace.append({size, lifetime, static_cast<quint16>(thread)});
+        }
+    }
+    return trace;
+}
+
+// sizes following a log-normal distribution with a median of 64 bytes
+inline AllocationTrace generateLogNormalTrace(size_t eventsPerThread, int numThreads)
+{
+    std::lognormal_distribution<double> distribution(std::log(64.), 1.);
+    return generateTrace(eventsPerThread, numThreads, [distribution](std::mt19937& generator) mutable {
+        return static_cast<quint32>(std::min(1024. * 1024., std::max(1., distribution(generator))));
+    });
+}
+
+// mostly small sizes: 80% up to 64 bytes, 15% up to 512 bytes, 5% up to 64KB
+inline AllocationTrace generateSmallHeavyTrace(size_t eventsPerThread, int numThreads)
+{
+    std::discrete_distribution<int> bucket({80, 15, 5});
+    std::uniform_int_distribution<quint32> small(8, 64);
+    std::uniform_int_distribution<quint32> medium(65, 512);
+    std::uniform_int_distribution<quint32> large(513, 64 * 1024);
+    return generateTrace(eventsPerThread, numThreads, [=](std::mt19937& generator) mutable {
+        switch (bucket(generator)) {
+        case 0:
+            return small(generator);
+        case 1:
+            return medium(generator);
+        default:
+            return large(generator);
+        }
+    });
+}
+
+/**
+ * The operations of one thread of a trace, flattened such that replaying them
+ * does not need any bookkeeping beyond a table of live pointers.
+ */
+struct ReplayOperation
+{
+    quint32 slot;
+    quint32 size;
+    bool free;
+};
+
+inline std::vector<ReplayOperation> replayOperations(const AllocationTrace& trace, int thread)
+{
+    std::vector<ReplayOperation> operations;
+    // (step after which to free, slot)
+    std::vector<std::pair<quint64, quint32>> frees;
+    std::vector<quint32> sizes;
+    for (const auto& event : trace.events()) {
+        if (event.thread != thread) {
+            continue;
+        }
+        const quint32 slot = static_cast<quint32>(sizes.size());
+        frees.emplace_back(static_cast<quint64>(slot) + event.lifetime, slot);
+        sizes.push_back(event.size);
+    }
+    std::sort(frees.begin(), frees.end());
+
+    auto nextFree = frees.begin();
+    for (quint32 slot = 0; slot < sizes.size(); ++slot) {
+        operations.push_back({slot, sizes[slot], false});
+        for (; nextFree != frees.end() && nextFree->first <= slot; ++nextFree) {
+            operations.push_back({nextFree->second, sizes[nextFree->second], true});
+        }
+    }
+    for (; nextFree != frees.end(); ++nextFree) {
+        operations.push_back({nextFree->second, sizes[nextFree->second], true});
+    }
+    return operations;
+}
+
+/**
+ * Replay @p operations against @p allocator, using @p pointers to keep track
+ * of the live pointers.
+ */
+template<typename Allocator>
+void replay(const std::vector<ReplayOperation>& operations, std::vector<void*>& pointers, Allocator allocator)
+{
+    for (const auto& operation : operations) {
+        if (operation.free) {
+            allocator.deallocate(pointers[operation.slot], operation.size);
+        } else {
+            pointers[operation.slot] = allocator.allocate(operation.size);
+        }
+    }
+    allocator.reset();
+}
+
+#endif
@@ -0,0 +1,351 @@
+/**
+ *
+ * Copyright (C) 2015 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com, author Milian Wolff <milian.wolff@kdab.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef BENCH_QT_ALLOCATORS_H
+#define BENCH_QT_ALLOCATORS_H
+
+#include <QMetaType>
+
+#include <cstdlib>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/**
+ * The allocators the benchmarks in bench_alloc can run against.
+ *
+ * All allocators share the same interface:
+ *
+ * - void* allocate(size_t size)
+ * - void deallocate(void* p, size_t size)
+ * - void reset(): releases everything the current thread allocated, for
+ *   allocators which cannot free individual allocations
+ *
+ * The allocator objects themselves are stateless handles to thread local
+ * state, such that they can be copied freely and used from any thread.
+ */
+enum class AllocatorBackend
+{
+    // whatever malloc is in use, i.e. glibc or e.g. jemalloc/tcmalloc via LD_PRELOAD
+    Malloc,
+    // a thread local bump allocator which never frees individual allocations
+    BumpArena,
+    // thread local free lists for power-of-two size classes
+    SizeClassPool
+};
+Q_DECLARE_METATYPE(AllocatorBackend)
+
+inline const char* backendName(AllocatorBackend backend)
+{
+    switch (backend) {
+    case AllocatorBackend::Malloc:
+        return "malloc";
+    case AllocatorBackend::BumpArena:
+        return "arena";
+    case AllocatorBackend::SizeClassPool:
+        return "pool";
+    }
+    return "unknown";
+}
+
+const AllocatorBackend ALLOCATOR_BACKENDS[] = {
+    AllocatorBackend::Malloc,
+    AllocatorBackend::BumpArena,
+    AllocatorBackend::SizeClassPool
+};
+
+class MallocAllocator
+{
+public:
+    void* allocate(size_t size)
+    {
+        return malloc(size);
+    }
+
+    void deallocate(void* p, size_t /*size*/)
+    {
+        free(p);
+    }
+
+    void reset()
+    {
+    }
+};
+
+/**
+ * Allocations are served by incrementing a pointer into large chunks of
+ * memory. Deallocation is a no-op, all memory is released at once via reset().
+ * The chunks are kept around for reuse until the thread exits.
+ */
+class BumpArenaAllocator
+{
+public:
+    void* allocate(size_t size)
+    {
+        auto& arena = threadArena();
+        size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+        if (Q_UNLIKELY(size > static_cast<size_t>(arena.end - arena.pos))) {
+            arena.nextChunk(size);
+        }
+        void* p = arena.pos;
+        arena.pos += size;
+        return p;
+    }
+
+    void deallocate(void* /*p*/, size_t /*size*/)
+    {
+    }
+
+    void reset()
+    {
+        threadArena().rewind();
+    }
+
+private:
+    static const size_t ALIGNMENT = 16;
+    static const size_t CHUNK_SIZE = 1024 * 1024;
+
+    struct Arena
+    {
+        ~Arena()
+        {
+            for (const auto& chunk : chunks) {
+                free(chunk.first);
+            }
+        }
+
+        void nextChunk(size_t size)
+        {
+            // try to reuse the chunks left over from before the last rewind
+            while (++current < chunks.size()) {
+                if (chunks[current].second >= size) {
+                    setChunk(current);
+                    return;
+                }
+            }
+            const size_t chunkSize = size > CHUNK_SIZE ? size : CHUNK_SIZE;
+            chunks.emplace_back(static_cast<char*>(malloc(chunkSize)), chunkSize);
+            current = chunks.size() - 1;
+            setChunk(current);
+        }
+
+        void rewind()
+        {
+            current = 0;
+            if (chunks.empty()) {
+                pos = end = nullptr;
+            } else {
+                setChunk(0);
+            }
+        }
+
+        void setChunk(size_t index)
+        {
+            pos = chunks[index].first;
+            end = pos + chunks[index].second;
+        }
+
+        std::vector<std::pair<char*, size_t>> chunks;
+        size_t current = 0;
+        char* pos = nullptr;
+        char* end = nullptr;
+    };
+
+    static Arena& threadArena()
+    {
+        static thread_local Arena arena;
+        return arena;
+    }
+};
+
+/**
+ * Allocations up to MAX_POOLED_SIZE are rounded up to the next power of two
+ * and served from a thread local free list for that size class. The free lists
+ * are refilled by carving up larger slabs. Larger allocations go to malloc.
+ *
+ * Memory can be deallocated on a different thread than it was allocated on,
+ * it then ends up in the free list of the deallocating thread. When a thread
+ * exits, its free lists are handed over to a global depot from which other
+ * threads refill. Slabs are only returned to the system on exit.
+ */
+class SizeClassPoolAllocator
+{
+public:
+    static const size_t MIN_POOLED_SIZE = 16;
+    static const size_t MAX_POOLED_SIZE = 4096;
+
+    void* allocate(size_t size)
+    {
+        if (Q_UNLIKELY(size > MAX_POOLED_SIZE)) {
+            return malloc(size);
+        }
+        const size_t index = sizeClass(size);
+        auto& list = threadPool().lists[index];
+        if (Q_UNLIKELY(!list)) {
+            list = refill(index);
+        }
+        Block* block = list;
+        list = block->next;
+        return block;
+    }
+
+    void deallocate(void* p, size_t size)
+    {
+        if (Q_UNLIKELY(size > MAX_POOLED_SIZE)) {
+            free(p);
+            return;
+        }
+        auto& list = threadPool().lists[sizeClass(size)];
+        Block* block = static_cast<Block*>(p);
+        block->next = list;
+        list = block;
+    }
+
+    void reset()
+    {
+    }
+
+private:
+    static const size_t NUM_SIZE_CLASSES = 9; // 16, 32, ..., 4096
+    static const size_t SLAB_SIZE = 64 * 1024;
+
+    struct Block
+    {
+        Block* next;
+    };
+
+    static size_t sizeClass(size_t size)
+    {
+        if (size <= MIN_POOLED_SIZE) {
+            return 0;
+        }
+        // ceil(log2(size)) - log2(MIN_POOLED_SIZE)
+        return (sizeof(unsigned long long) * 8) - __builtin_clzll(size - 1) - 4;
+    }
+
+    static size_t classSize(size_t sizeClass)
+    {
+        return MIN_POOLED_SIZE << sizeClass;
+    }
+
+    struct Pool
+    {
+        ~Pool();
+
+        Block* lists[NUM_SIZE_CLASSES] = {};
+    };
+
+    static Pool& threadPool()
+    {
+        static thread_local Pool pool;
+        return pool;
+    }
+
+    struct Depot
+    {
+        ~Depot()
+        {
+            for (void* slab : slabs) {
+                free(slab);
+            }
+        }
+
+        std::mutex mutex;
+        Block* lists[NUM_SIZE_CLASSES] = {};
+        std::vector<void*> slabs;
+    };
+
+    static Depot& depot()
+    {
+        static Depot depot;
+        return depot;
+    }
+
+    static Block* refill(size_t sizeClass)
+    {
+        auto& global = depot();
+        std::lock_guard<std::mutex> lock(global.mutex);
+        if (Block* list = global.lists[sizeClass]) {
+            global.lists[sizeClass] = nullptr;
+            return list;
+        }
+
+        char* slab = static_cast<char*>(malloc(SLAB_SIZE));
+        global.slabs.push_back(slab);
+        const size_t blockSize = classSize(sizeClass);
+        const size_t numBlocks = SLAB_SIZE / blockSize;
+        for (size_t i = 0; i < numBlocks - 1; ++i) {
+            reinterpret_cast<Block*>(slab + i * blockSize)->next = reinterpret_cast<Block*>(slab + (i + 1) * blockSize);
+        }
+        reinterpret_cast<Block*>(slab + (numBlocks - 1) * blockSize)->next = nullptr;
+        return reinterpret_cast<Block*>(slab);
+    }
+};
+
+inline SizeClassPoolAllocator::Pool::~Pool()
+{
+    auto& global = depot();
+    std::lock_guard<std::mutex> lock(global.mutex);
+    for (size_t i = 0; i < NUM_SIZE_CLASSES; ++i) {
+        Block* list = lists[i];
+        if (!list) {
+            continue;
+        }
+        Block* last = list;
+        while (last->next) {
+            last = last->next;
+        }
+        last->next = global.lists[i];
+        global.lists[i] = list;
+    }
+}
+
+/**
+ * Call @p func with an allocator instance for @p backend.
+ */
+template<typename Func>
+void withAllocator(AllocatorBackend backend, Func func)
+{
+    switch (backend) {
+    case AllocatorBackend::Malloc:
+        func(MallocAllocator());
+        break;
+    case AllocatorBackend::BumpArena:
+        func(BumpArenaAllocator());
+        break;
+    case AllocatorBackend::SizeClassPool:
+        func(SizeClassPoolAllocator());
+        break;
+    }
+}
+
+#endif
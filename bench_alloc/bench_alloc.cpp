@@ -36,29 +36,403 @@
 
 #include <string>
 #include <vector>
+#include <algorithm>
+#include <numeric>
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <cstdio>
+
+#include <stdlib.h>
+
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#endif
+
+#if defined(Q_PROCESSOR_X86) && defined(__SSE2__)
+#include <immintrin.h>
+#define HAVE_STREAMING_COPY
+#endif
 
 #include "../util.h"
+#include "../report.h"
+#include "../stats.h"
+#include "allocators.h"
+#include "allocationtrace.h"
 
 namespace {
 const size_t NUM_ALLOCS = 10000;
+// the sizes used by the multi-threaded tests, which allocate NUM_ALLOCS per thread
+const size_t THREADED_SIZES[] = {16, 128, 1024};
+// the number of events per thread in the generated allocation traces
+const size_t TRACE_EVENTS = 20000;
+// the (depth, fan-out) shapes of the object trees, e.g. (5, 6) has 9331 nodes
+const std::pair<int, int> TREE_SHAPES[] = {{1, 1000}, {3, 10}, {5, 6}, {10, 2}};
+// the threaded copy only makes sense for large buffers, due to the synchronization overhead
+const size_t MIN_THREADED_COPY_SIZE = 1024 * 1024;
 
-template<typename T>
-void benchAllocType()
+template<typename T, typename Allocator>
+void benchAllocType(Allocator allocator)
 {
     QBENCHMARK {
         for (size_t i = 0; i < NUM_ALLOCS; ++i) {
-            T* p = new T;
+            T* p = new (allocator.allocate(sizeof(T))) T;
             escape(p);
-            delete p;
+            p->~T();
+            allocator.deallocate(p, sizeof(T));
             clobber();
             __iteration_controller.next();
         }
+        allocator.reset();
+    }
+}
+
+/**
+ * A @p Base which allocates itself through @p Allocator.
+ *
+ * This makes sure that object trees which get destroyed through their parent
+ * return the memory of their children to the right allocator.
+ */
+template<typename Base, typename Allocator>
+class AllocatedObject : public Base
+{
+public:
+    explicit AllocatedObject(Base* parent = nullptr)
+        : Base(parent)
+    {
+    }
+
+    static void* operator new(size_t size)
+    {
+        return Allocator().allocate(size);
+    }
+
+    static void operator delete(void* p, size_t size)
+    {
+        Allocator().deallocate(p, size);
+    }
+};
+
+template<typename Object>
+void buildTree(Object* parent, int depth, int fanOut)
+{
+    if (!depth) {
+        return;
+    }
+    for (int i = 0; i < fanOut; ++i) {
+        buildTree(new Object(parent), depth - 1, fanOut);
+    }
+}
+
+// bench building an object tree and then destroying it through its root
+template<typename Base, typename Allocator>
+void benchObjectTree(Allocator allocator, int depth, int fanOut)
+{
+    using Object = AllocatedObject<Base, Allocator>;
+    QBENCHMARK {
+        Object* root = new Object;
+        buildTree(root, depth, fanOut);
+        escape(root);
+        delete root;
+        allocator.reset();
+    }
+}
+
+// a buffer aligned to a cache line, with all of its pages faulted in
+class AlignedBuffer
+{
+public:
+    explicit AlignedBuffer(size_t size)
+    {
+        if (posix_memalign(reinterpret_cast<void**>(&m_data), 64, size) != 0) {
+            qFatal("failed to allocate %zu bytes", size);
+        }
+        memset(m_data, 1, size);
+    }
+
+    ~AlignedBuffer()
+    {
+        free(m_data);
+    }
+
+    char* data() const
+    {
+        return m_data;
+    }
+
+private:
+    Q_DISABLE_COPY(AlignedBuffer)
+
+    char* m_data = nullptr;
+};
+
+#ifdef HAVE_STREAMING_COPY
+// copy with non-temporal stores which bypass the cache,
+// @p target and @p source must be 16 byte aligned
+void streamingCopySse2(char* target, const char* source, size_t size)
+{
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64) {
+        const __m128i a = _mm_load_si128(reinterpret_cast<const __m128i*>(source + i));
+        const __m128i b = _mm_load_si128(reinterpret_cast<const __m128i*>(source + i + 16));
+        const __m128i c = _mm_load_si128(reinterpret_cast<const __m128i*>(source + i + 32));
+        const __m128i d = _mm_load_si128(reinterpret_cast<const __m128i*>(source + i + 48));
+        _mm_stream_si128(reinterpret_cast<__m128i*>(target + i), a);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(target + i + 16), b);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(target + i + 32), c);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(target + i + 48), d);
     }
+    _mm_sfence();
+    memcpy(target + i, source + i, size - i);
+}
+
+// like streamingCopySse2, but @p target and @p source must be 32 byte aligned
+__attribute__((target("avx")))
+void streamingCopyAvx(char* target, const char* source, size_t size)
+{
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64) {
+        const __m256i a = _mm256_load_si256(reinterpret_cast<const __m256i*>(source + i));
+        const __m256i b = _mm256_load_si256(reinterpret_cast<const __m256i*>(source + i + 32));
+        _mm256_stream_si256(reinterpret_cast<__m256i*>(target + i), a);
+        _mm256_stream_si256(reinterpret_cast<__m256i*>(target + i + 32), b);
+    }
+    _mm_sfence();
+    memcpy(target + i, source + i, size - i);
+}
+
+void streamingCopy(char* target, const char* source, size_t size)
+{
+    static const auto copy = __builtin_cpu_supports("avx") ? streamingCopyAvx : streamingCopySse2;
+    copy(target, source, size);
+}
+#endif
+
+// the number of bytes to copy per size in the bandwidth tests, 1GiB by default
+size_t bandwidthBytes()
+{
+    return size_t(BenchStats::envValue("BENCH_QT_BANDWIDTH_MIB", 1024)) * 1024 * 1024;
 }
+
+/**
+ * Copy @p size bytes with @p copy over and over until bandwidthBytes()
+ * got copied and report the bandwidth.
+ */
+template<typename Copy>
+void benchBandwidth(size_t size, Copy copy)
+{
+    AlignedBuffer source(size);
+    AlignedBuffer target(size);
+    // warm up
+    copy(target.data(), source.data(), size);
+
+    const size_t repetitions = std::max(size_t(3), bandwidthBytes() / size);
+    qint64 elapsed = 0;
+    {
+        PerfCounterScope counters;
+        QElapsedTimer timer;
+        timer.start();
+        for (size_t i = 0; i < repetitions; ++i) {
+            copy(target.data(), source.data(), size);
+            clobber();
+        }
+        elapsed = timer.nsecsElapsed();
+        counters.addIterations(repetitions);
+    }
+
+    const qreal bytesPerSecond = static_cast<qreal>(size) * repetitions * 1E9 / elapsed;
+    qDebug("%.2f GB/s", bytesPerSecond / 1E9);
+    QTest::setBenchmarkResult(bytesPerSecond, QTest::BytesPerSecond);
 }
 
 /**
- * Various benchmarks related to the system allocator.
+ * Copies a buffer in one chunk per thread. The threads are started once and
+ * then released for every copy by a spin barrier, such that the copies do
+ * not include the cost of starting and joining threads. The calling thread
+ * copies the first chunk itself.
+ */
+class ParallelCopy
+{
+public:
+    explicit ParallelCopy(int numThreads)
+        : m_numThreads(numThreads)
+    {
+        for (int thread = 1; thread < numThreads; ++thread) {
+            m_threads.emplace_back([this, thread] { work(thread); });
+        }
+    }
+
+    ~ParallelCopy()
+    {
+        m_stop.store(true);
+        m_generation.fetch_add(1, std::memory_order_release);
+        for (auto& thread : m_threads) {
+            thread.join();
+        }
+    }
+
+    void operator()(char* target, const char* source, size_t size)
+    {
+        m_target = target;
+        m_source = source;
+        m_size = size;
+        // all workers are done with the previous copy, see below
+        m_done.store(0, std::memory_order_relaxed);
+        m_generation.fetch_add(1, std::memory_order_release);
+        copyChunk(0);
+        while (m_done.load(std::memory_order_acquire) != m_numThreads - 1) {
+            std::this_thread::yield();
+        }
+    }
+
+private:
+    void work(int thread)
+    {
+        unsigned generation = 0;
+        while (true) {
+            unsigned next = 0;
+            while ((next = m_generation.load(std::memory_order_acquire)) == generation) {
+                std::this_thread::yield();
+            }
+            generation = next;
+            if (m_stop.load()) {
+                return;
+            }
+            copyChunk(thread);
+            m_done.fetch_add(1, std::memory_order_release);
+        }
+    }
+
+    void copyChunk(int thread)
+    {
+        const size_t chunkSize = ((m_size + m_numThreads - 1) / m_numThreads + 63) & ~size_t(63);
+        const size_t begin = std::min(m_size, thread * chunkSize);
+        const size_t end = std::min(m_size, begin + chunkSize);
+        memcpy(m_target + begin, m_source + begin, end - begin);
+    }
+
+    const int m_numThreads;
+    std::vector<std::thread> m_threads;
+    std::atomic<unsigned> m_generation{0};
+    std::atomic<int> m_done{0};
+    std::atomic<bool> m_stop{false};
+    char* m_target = nullptr;
+    const char* m_source = nullptr;
+    size_t m_size = 0;
+};
+
+// spin until all @p numThreads threads have called this function
+void waitForThreads(std::atomic<int>& arrived, int numThreads)
+{
+    ++arrived;
+    while (arrived.load() != numThreads) {
+        std::this_thread::yield();
+    }
+}
+
+std::vector<size_t> randomSizes(size_t count)
+{
+    std::vector<size_t> sizes(count);
+    // this distribution has it's mean value at 128, but assumes the tails
+    // on both sides are equally common which is not the case.
+    // TODO: use a different distribution to favor small allocations
+    std::generate(sizes.begin(), sizes.end(), [] { return 1 << (std::rand() % 12 + 1); });
+    return sizes;
+}
+
+// @return the resident set size of this process in bytes, or -1 if unknown
+qint64 residentSetSize()
+{
+#ifdef Q_OS_LINUX
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (!statm) {
+        return -1;
+    }
+    long long size = 0;
+    long long resident = 0;
+    const int read = fscanf(statm, "%lld %lld", &size, &resident);
+    fclose(statm);
+    return read == 2 ? resident * sysconf(_SC_PAGESIZE) : -1;
+#else
+    return -1;
+#endif
+}
+
+/**
+ * Report the result of a multi-threaded test, where each thread took
+ * @p threadElapsed nanoseconds for @p threadOps operations.
+ *
+ * The benchmark result is the average time per operation as seen by a single
+ * thread, which is directly comparable to the single-threaded tests.
+ */
+void reportThreaded(const std::vector<qint64>& threadElapsed, const std::vector<size_t>& threadOps, qint64 rssBefore)
+{
+    qint64 totalElapsed = 0;
+    size_t totalOps = 0;
+    qreal slowest = 0;
+    for (size_t i = 0; i < threadElapsed.size(); ++i) {
+        if (!threadOps[i]) {
+            continue;
+        }
+        totalElapsed += threadElapsed[i];
+        totalOps += threadOps[i];
+        slowest = std::max(slowest, static_cast<qreal>(threadElapsed[i]) / threadOps[i]);
+    }
+    const qreal nsPerOp = static_cast<qreal>(totalElapsed) / totalOps;
+    const qint64 rssAfter = residentSetSize();
+    const qint64 rssGrowth = (rssBefore >= 0 && rssAfter >= 0) ? (rssAfter - rssBefore) / 1024 : -1;
+
+    qDebug("%d threads: %.0f ops/sec per thread, slowest thread: %.0f ops/sec, RSS growth: %lld KiB",
+           static_cast<int>(threadElapsed.size()), 1E9 / nsPerOp, 1E9 / slowest, rssGrowth);
+    QTest::setBenchmarkResult(nsPerOp, QTest::WalltimeNanoseconds);
+}
+
+void reportThreaded(const std::vector<qint64>& threadElapsed, size_t opsPerThread, qint64 rssBefore)
+{
+    reportThreaded(threadElapsed, std::vector<size_t>(threadElapsed.size(), opsPerThread), rssBefore);
+}
+
+/**
+ * A bounded lock-free single-producer single-consumer queue,
+ * used to pass allocations from one thread to another.
+ */
+class PointerQueue
+{
+public:
+    bool push(void* p)
+    {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) == CAPACITY) {
+            return false;
+        }
+        m_buffer[tail % CAPACITY] = p;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    void* pop()
+    {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        void* p = m_buffer[head % CAPACITY];
+        m_head.store(head + 1, std::memory_order_release);
+        return p;
+    }
+
+private:
+    static const size_t CAPACITY = 1024;
+    void* m_buffer[CAPACITY];
+    // keep head and tail on separate cache lines, without requiring aligned new
+    std::atomic<size_t> m_head{0};
+    char m_padding[64];
+    std::atomic<size_t> m_tail{0};
+};
+}
+
+/**
+ * Various benchmarks related to the system allocator and alternatives to it.
  *
  * Note that all test cases bench both, allocation and deallocation.
  * The returned numbers should roughly correspond to the cost of an allocation
@@ -70,45 +444,104 @@ void benchAllocType()
  * stays code stays in cache, ...
  *
  * Still, the results are interesting nonetheless.
+ *
+ * The *Threaded tests run the same patterns on 1, 2, 4, ... up to
+ * hardware_concurrency threads at the same time, such that the threads contend
+ * for the heap. benchCrossThreadFree additionally frees the memory on another
+ * thread than the one which allocated it, as is common for producer/consumer
+ * queues. These tests report the average time per operation as seen by a
+ * single thread, and print the per-thread throughput as well as the growth
+ * of the resident set size as debug output. Note that the latter is cumulative
+ * as the allocator usually keeps its per-thread arenas around.
+ *
+ * All allocation tests run against every AllocatorBackend, see allocators.h.
+ * The "malloc" backend is whatever malloc is in use, run the benchmark with
+ * e.g. LD_PRELOAD=libjemalloc.so to compare different implementations.
+ * The "arena" backend never frees individual allocations, instead its memory
+ * is released at once at the end of each iteration.
+ *
+ * benchTraceReplay replays allocation traces with interleaved lifetimes, see
+ * allocationtrace.h. Next to generated traces with log-normal and small-heavy
+ * size distributions, traces can be loaded from files by setting
+ * BENCH_ALLOC_TRACES to a comma separated list of paths. Compare the printed
+ * RSS growth to the peak live memory of the trace to see the fragmentation.
+ *
+ * benchObjectTree* build parent/child trees of various shapes and destroy them
+ * through the root. The objects themselves come from the allocator backend,
+ * their private data and child lists still use the global heap. The difference
+ * to the "malloc" rows is thus what an arena or pool can save at most.
+ *
+ * benchBandwidth* copy buffers from 64 bytes up to 256MB, i.e. through all
+ * cache levels into DRAM, and report the bandwidth instead of the time per
+ * call. memmove and std::copy are called with non-overlapping buffers, to see
+ * whether they are any slower than memcpy for that case. Each size copies 1GiB
+ * in total, set BENCH_QT_BANDWIDTH_MIB to change that.
  */
 class BenchAlloc : public QObject
 {
     Q_OBJECT
 
 private slots:
+    void initTestCase()
+    {
+        const char* preload = getenv("LD_PRELOAD");
+        qDebug("malloc backend: %s", preload ? preload : "system default");
+    }
+
+    void init()
+    {
+        BenchReport::startPerfCounters();
+    }
+
+    void cleanup()
+    {
+        BenchReport::stopPerfCounters();
+    }
+
+    Q_NEVER_INLINE void benchBackend_data()
+    {
+        QTest::addColumn<AllocatorBackend>("backend");
+        for (AllocatorBackend backend : ALLOCATOR_BACKENDS) {
+            QTest::newRow(backendName(backend)) << backend;
+        }
+    }
+
     Q_NEVER_INLINE void benchMalloc_data()
     {
+        QTest::addColumn<AllocatorBackend>("backend");
         QTest::addColumn<size_t>("size");
-        for (size_t i = 1; i <= 12; ++i) {
-            size_t size = 1 << i;
-            QTest::newRow(std::to_string(size).data()) << size;
+        for (AllocatorBackend backend : ALLOCATOR_BACKENDS) {
+            for (size_t i = 1; i <= 12; ++i) {
+                size_t size = 1 << i;
+                QTest::newRow((backendName(backend) + ('/' + std::to_string(size))).data()) << backend << size;
+            }
         }
     }
 
     // bench repeated malloc for various constant sizes
     Q_NEVER_INLINE void benchMalloc()
     {
+        QFETCH(AllocatorBackend, backend);
         QFETCH(size_t, size);
 
-        QVector<void*> ptrs(NUM_ALLOCS);
+        withAllocator(backend, [&](auto allocator) {
+            QVector<void*> ptrs(NUM_ALLOCS);
 
-        QBENCHMARK {
-            for (size_t i = 0; i < NUM_ALLOCS; ++i) {
-                void* p = malloc(size);
-                escape(p);
-                ptrs[i] = p;
-                clobber();
-                __iteration_controller.next();
-            }
-            clobber();
-            // TODO: find a way to do this outside of the measured section
-            //       but b/c QBENCHMARK uses the median value this should still
-            //       be OK
-            for (size_t i = 0; i < NUM_ALLOCS; ++i) {
-                free(ptrs[i]);
-            }
-            __iteration_controller.next();
-        }
+            // only the allocations are measured, the frees happen in the untimed teardown
+            BenchStats::report(BenchStats::measure(NUM_ALLOCS, [] {}, [&] {
+                for (size_t i = 0; i < NUM_ALLOCS; ++i) {
+                    void* p = allocator.allocate(size);
+                    escape(p);
+                    ptrs[i] = p;
+                    clobber();
+                }
+            }, [&] {
+                for (size_t i = 0; i < NUM_ALLOCS; ++i) {
+                    allocator.deallocate(ptrs[i], size);
+                }
+                allocator.reset();
+            }));
+        });
     }
 
     Q_NEVER_INLINE void benchFree_data()
@@ -116,28 +549,30 @@ private slots:
         benchMalloc_data();
     }
 
-    // bench repeated malloc for various constant sizes
+    // bench repeated free for various constant sizes
     Q_NEVER_INLINE void benchFree()
     {
+        QFETCH(AllocatorBackend, backend);
         QFETCH(size_t, size);
 
-        QVector<void*> ptrs(NUM_ALLOCS);
+        withAllocator(backend, [&](auto allocator) {
+            QVector<void*> ptrs(NUM_ALLOCS);
 
-        QBENCHMARK {
-            // TODO: find a way to do this outside of the measured section
-            //       but b/c QBENCHMARK uses the median value this should still
-            //       be OK
-            for (size_t i = 0; i < NUM_ALLOCS; ++i) {
-                ptrs[i] = malloc(size);
-            }
-            __iteration_controller.next();
-            clobber();
-            for (size_t i = 0; i < NUM_ALLOCS; ++i) {
-                free(ptrs[i]);
+            // only the frees are measured, the allocations happen in the untimed setup
+            BenchStats::report(BenchStats::measure(NUM_ALLOCS, [&] {
+                for (size_t i = 0; i < NUM_ALLOCS; ++i) {
+                    ptrs[i] = allocator.allocate(size);
+                }
                 clobber();
-                __iteration_controller.next();
-            }
-        }
+            }, [&] {
+                for (size_t i = 0; i < NUM_ALLOCS; ++i) {
+                    allocator.deallocate(ptrs[i], size);
+                    clobber();
+                }
+            }, [&] {
+                allocator.reset();
+            }));
+        });
     }
 
     Q_NEVER_INLINE void benchMallocFree_data()
@@ -148,53 +583,128 @@ private slots:
     // bench repeated malloc and free for various constant sizes
     Q_NEVER_INLINE void benchMallocFree()
     {
+        QFETCH(AllocatorBackend, backend);
         QFETCH(size_t, size);
 
-        QBENCHMARK {
-            for (size_t i = 0; i < NUM_ALLOCS; ++i) {
-                void* p = malloc(size);
-                escape(p);
-                free(p);
-                clobber();
-                __iteration_controller.next();
+        withAllocator(backend, [&](auto allocator) {
+            QBENCHMARK {
+                for (size_t i = 0; i < NUM_ALLOCS; ++i) {
+                    void* p = allocator.allocate(size);
+                    escape(p);
+                    allocator.deallocate(p, size);
+                    clobber();
+                    __iteration_controller.next();
+                }
+                allocator.reset();
             }
-        }
+        });
+    }
+
+    Q_NEVER_INLINE void benchMallocFreeRand_data()
+    {
+        benchBackend_data();
     }
 
     // bench repeated malloc and free with randomized sizes
     Q_NEVER_INLINE void benchMallocFreeRand()
     {
-        std::vector<size_t> sizes(NUM_ALLOCS);
-        // this distribution has it's mean value at 128, but assumes the tails
-        // on both sides are equally common which is not the case.
-        // TODO: use a different distribution to favor small allocations
-        std::generate(sizes.begin(), sizes.end(), [] { return 1 << (std::rand() % 12 + 1); });
-        QBENCHMARK {
-            for (size_t i = 0; i < NUM_ALLOCS; ++i) {
-                void* p = malloc(sizes[i]);
-                escape(p);
-                free(p);
-                clobber();
-                __iteration_controller.next();
+        QFETCH(AllocatorBackend, backend);
+
+        const std::vector<size_t> sizes = randomSizes(NUM_ALLOCS);
+        withAllocator(backend, [&](auto allocator) {
+            QBENCHMARK {
+                for (size_t i = 0; i < NUM_ALLOCS; ++i) {
+                    void* p = allocator.allocate(sizes[i]);
+                    escape(p);
+                    allocator.deallocate(p, sizes[i]);
+                    clobber();
+                    __iteration_controller.next();
+                }
+                allocator.reset();
             }
-        }
+        });
+    }
+
+    Q_NEVER_INLINE void benchAllocQObject_data()
+    {
+        benchBackend_data();
     }
 
     // bench the repeated (de)allocation of QObject
     Q_NEVER_INLINE void benchAllocQObject()
     {
-        benchAllocType<QObject>();
+        QFETCH(AllocatorBackend, backend);
+        withAllocator(backend, [](auto allocator) {
+            benchAllocType<QObject>(allocator);
+        });
+    }
+
+    Q_NEVER_INLINE void benchAllocQWidget_data()
+    {
+        benchBackend_data();
     }
 
     // bench the repeated (de)allocation of QObject
     Q_NEVER_INLINE void benchAllocQWidget()
     {
-        benchAllocType<QWidget>();
+        QFETCH(AllocatorBackend, backend);
+        withAllocator(backend, [](auto allocator) {
+            benchAllocType<QWidget>(allocator);
+        });
+    }
+
+    Q_NEVER_INLINE void benchObjectTree_data()
+    {
+        QTest::addColumn<AllocatorBackend>("backend");
+        QTest::addColumn<int>("depth");
+        QTest::addColumn<int>("fanOut");
+        for (AllocatorBackend backend : ALLOCATOR_BACKENDS) {
+            for (const auto& shape : TREE_SHAPES) {
+                const std::string name = backendName(backend) + ('/' + std::to_string(shape.first) + 'x' + std::to_string(shape.second));
+                QTest::newRow(name.data()) << backend << shape.first << shape.second;
+            }
+        }
+    }
+
+    Q_NEVER_INLINE void benchObjectTreeQObject_data()
+    {
+        benchObjectTree_data();
+    }
+
+    // bench building and destroying QObject trees of depth x fanOut
+    Q_NEVER_INLINE void benchObjectTreeQObject()
+    {
+        QFETCH(AllocatorBackend, backend);
+        QFETCH(int, depth);
+        QFETCH(int, fanOut);
+        withAllocator(backend, [&](auto allocator) {
+            benchObjectTree<QObject>(allocator, depth, fanOut);
+        });
+    }
+
+    Q_NEVER_INLINE void benchObjectTreeQWidget_data()
+    {
+        benchObjectTree_data();
+    }
+
+    // bench building and destroying QWidget trees of depth x fanOut
+    Q_NEVER_INLINE void benchObjectTreeQWidget()
+    {
+        QFETCH(AllocatorBackend, backend);
+        QFETCH(int, depth);
+        QFETCH(int, fanOut);
+        withAllocator(backend, [&](auto allocator) {
+            benchObjectTree<QWidget>(allocator, depth, fanOut);
+        });
     }
 
     Q_NEVER_INLINE void benchMemcpy_data()
     {
-        benchMallocFree_data();
+        QTest::addColumn<size_t>("size");
+        for (size_t i = 1; i <= 12; ++i) {
+            size_t size = 1 << i;
+            QTest::newRow(std::to_string(size).data()) << size;
+        }
     }
 
     Q_NEVER_INLINE void benchMemcpy()
@@ -207,8 +717,359 @@ private slots:
             clobber();
         }
     }
+
+    Q_NEVER_INLINE void benchBandwidth_data()
+    {
+        QTest::addColumn<size_t>("size");
+        for (size_t size = 64; size <= 256 * 1024 * 1024; size *= 4) {
+            QTest::newRow(std::to_string(size).data()) << size;
+        }
+    }
+
+    Q_NEVER_INLINE void benchBandwidthMemcpy_data()
+    {
+        benchBandwidth_data();
+    }
+
+    Q_NEVER_INLINE void benchBandwidthMemcpy()
+    {
+        QFETCH(size_t, size);
+        benchBandwidth(size, [](char* target, const char* source, size_t size) {
+            memcpy(target, source, size);
+        });
+    }
+
+    Q_NEVER_INLINE void benchBandwidthMemmove_data()
+    {
+        benchBandwidth_data();
+    }
+
+    Q_NEVER_INLINE void benchBandwidthMemmove()
+    {
+        QFETCH(size_t, size);
+        benchBandwidth(size, [](char* target, const char* source, size_t size) {
+            memmove(target, source, size);
+        });
+    }
+
+    Q_NEVER_INLINE void benchBandwidthStdCopy_data()
+    {
+        benchBandwidth_data();
+    }
+
+    Q_NEVER_INLINE void benchBandwidthStdCopy()
+    {
+        QFETCH(size_t, size);
+        benchBandwidth(size, [](char* target, const char* source, size_t size) {
+            std::copy(source, source + size, target);
+        });
+    }
+
+    Q_NEVER_INLINE void benchBandwidthStreamingCopy_data()
+    {
+        benchBandwidth_data();
+    }
+
+    // non-temporal stores, which should only pay off once the buffers exceed the cache
+    Q_NEVER_INLINE void benchBandwidthStreamingCopy()
+    {
+#ifdef HAVE_STREAMING_COPY
+        QFETCH(size_t, size);
+        benchBandwidth(size, streamingCopy);
+#else
+        QSKIP("streaming copy is not implemented for this platform");
+#endif
+    }
+
+    Q_NEVER_INLINE void benchBandwidthThreadedCopy_data()
+    {
+        QTest::addColumn<size_t>("size");
+        for (size_t size = MIN_THREADED_COPY_SIZE; size <= 256 * 1024 * 1024; size *= 4) {
+            QTest::newRow(std::to_string(size).data()) << size;
+        }
+    }
+
+    // split the buffer into one chunk per hardware thread and copy them in parallel
+    Q_NEVER_INLINE void benchBandwidthThreadedCopy()
+    {
+        QFETCH(size_t, size);
+        ParallelCopy parallelCopy(threadCounts().last());
+        benchBandwidth(size, [&parallelCopy](char* target, const char* source, size_t size) {
+            parallelCopy(target, source, size);
+        });
+    }
+
+    Q_NEVER_INLINE void benchThreaded_data()
+    {
+        QTest::addColumn<AllocatorBackend>("backend");
+        QTest::addColumn<size_t>("size");
+        QTest::addColumn<int>("threads");
+        for (AllocatorBackend backend : ALLOCATOR_BACKENDS) {
+            for (size_t size : THREADED_SIZES) {
+                foreach (int threads, threadCounts()) {
+                    const std::string name = backendName(backend) + ('/' + std::to_string(size) + '/' + std::to_string(threads));
+                    QTest::newRow(name.data()) << backend << size << threads;
+                }
+            }
+        }
+    }
+
+    Q_NEVER_INLINE void benchMallocThreaded_data()
+    {
+        benchThreaded_data();
+    }
+
+    // bench concurrent malloc for various constant sizes, free is not measured
+    Q_NEVER_INLINE void benchMallocThreaded()
+    {
+        QFETCH(AllocatorBackend, backend);
+        QFETCH(size_t, size);
+        QFETCH(int, threads);
+
+        std::vector<std::vector<void*>> ptrs(threads, std::vector<void*>(NUM_ALLOCS));
+        std::vector<qint64> elapsed(threads);
+        std::atomic<int> allocated(0);
+        const qint64 rssBefore = residentSetSize();
+
+        withAllocator(backend, [&](auto allocator) {
+            runThreads(threads, [&](int thread) {
+                auto& threadPtrs = ptrs[thread];
+                QElapsedTimer timer;
+                timer.start();
+                for (size_t i = 0; i < NUM_ALLOCS; ++i) {
+                    void* p = allocator.allocate(size);
+                    escape(p);
+                    threadPtrs[i] = p;
+                    clobber();
+                }
+                elapsed[thread] = timer.nsecsElapsed();
+
+                waitForThreads(allocated, threads);
+                for (void* p : threadPtrs) {
+                    allocator.deallocate(p, size);
+                }
+                allocator.reset();
+            });
+        });
+
+        reportThreaded(elapsed, NUM_ALLOCS, rssBefore);
+    }
+
+    Q_NEVER_INLINE void benchFreeThreaded_data()
+    {
+        benchThreaded_data();
+    }
+
+    // bench concurrent free for various constant sizes, malloc is not measured
+    Q_NEVER_INLINE void benchFreeThreaded()
+    {
+        QFETCH(AllocatorBackend, backend);
+        QFETCH(size_t, size);
+        QFETCH(int, threads);
+
+        std::vector<std::vector<void*>> ptrs(threads, std::vector<void*>(NUM_ALLOCS));
+        std::vector<qint64> elapsed(threads);
+        std::atomic<int> allocated(0);
+        const qint64 rssBefore = residentSetSize();
+
+        withAllocator(backend, [&](auto allocator) {
+            runThreads(threads, [&](int thread) {
+                auto& threadPtrs = ptrs[thread];
+                for (auto& p : threadPtrs) {
+                    p = allocator.allocate(size);
+                }
+
+                waitForThreads(allocated, threads);
+                QElapsedTimer timer;
+                timer.start();
+                for (void* p : threadPtrs) {
+                    allocator.deallocate(p, size);
+                    clobber();
+                }
+                elapsed[thread] = timer.nsecsElapsed();
+                allocator.reset();
+            });
+        });
+
+        reportThreaded(elapsed, NUM_ALLOCS, rssBefore);
+    }
+
+    Q_NEVER_INLINE void benchMallocFreeRandThreaded_data()
+    {
+        QTest::addColumn<AllocatorBackend>("backend");
+        QTest::addColumn<int>("threads");
+        for (AllocatorBackend backend : ALLOCATOR_BACKENDS) {
+            foreach (int threads, threadCounts()) {
+                QTest::newRow((backendName(backend) + ('/' + std::to_string(threads))).data()) << backend << threads;
+            }
+        }
+    }
+
+    // bench concurrent malloc and free with randomized sizes
+    Q_NEVER_INLINE void benchMallocFreeRandThreaded()
+    {
+        QFETCH(AllocatorBackend, backend);
+        QFETCH(int, threads);
+
+        std::vector<std::vector<size_t>> sizes(threads);
+        std::generate(sizes.begin(), sizes.end(), [] { return randomSizes(NUM_ALLOCS); });
+        std::vector<qint64> elapsed(threads);
+        const qint64 rssBefore = residentSetSize();
+
+        withAllocator(backend, [&](auto allocator) {
+            runThreads(threads, [&](int thread) {
+                QElapsedTimer timer;
+                timer.start();
+                for (size_t size : sizes[thread]) {
+                    void* p = allocator.allocate(size);
+                    escape(p);
+                    allocator.deallocate(p, size);
+                    clobber();
+                }
+                elapsed[thread] = timer.nsecsElapsed();
+                allocator.reset();
+            });
+        });
+
+        reportThreaded(elapsed, NUM_ALLOCS, rssBefore);
+    }
+
+    Q_NEVER_INLINE void benchCrossThreadFree_data()
+    {
+        // the threads run in pairs, thus odd counts are rounded down
+        QVector<int> counts;
+        foreach (int threads, threadCounts()) {
+            const int even = threads & ~1;
+            if (even >= 2 && !counts.contains(even)) {
+                counts << even;
+            }
+        }
+        if (counts.isEmpty()) {
+            QSKIP("needs at least two hardware threads");
+        }
+
+        QTest::addColumn<AllocatorBackend>("backend");
+        QTest::addColumn<size_t>("size");
+        QTest::addColumn<int>("threads");
+        for (AllocatorBackend backend : ALLOCATOR_BACKENDS) {
+            for (size_t size : THREADED_SIZES) {
+                foreach (int threads, counts) {
+                    const std::string name = backendName(backend) + ('/' + std::to_string(size) + '/' + std::to_string(threads));
+                    QTest::newRow(name.data()) << backend << size << threads;
+                }
+            }
+        }
+    }
+
+    // bench pairs of threads where one thread allocates and the other one frees
+    // the memory, the result is the time per allocation passed between them
+    Q_NEVER_INLINE void benchCrossThreadFree()
+    {
+        QFETCH(AllocatorBackend, backend);
+        QFETCH(size_t, size);
+        QFETCH(int, threads);
+
+        const int pairs = threads / 2;
+        std::unique_ptr<PointerQueue[]> queues(new PointerQueue[pairs]);
+        std::vector<qint64> elapsed(pairs * 2);
+        const qint64 rssBefore = residentSetSize();
+
+        withAllocator(backend, [&](auto allocator) {
+            runThreads(pairs * 2, [&](int thread) {
+                auto& queue = queues[thread / 2];
+                QElapsedTimer timer;
+                timer.start();
+                if (thread % 2 == 0) {
+                    for (size_t i = 0; i < NUM_ALLOCS; ++i) {
+                        void* p = allocator.allocate(size);
+                        escape(p);
+                        while (!queue.push(p)) {
+                            std::this_thread::yield();
+                        }
+                    }
+                } else {
+                    for (size_t i = 0; i < NUM_ALLOCS; ++i) {
+                        void* p = nullptr;
+                        while (!(p = queue.pop())) {
+                            std::this_thread::yield();
+                        }
+                        allocator.deallocate(p, size);
+                        clobber();
+                    }
+                }
+                elapsed[thread] = timer.nsecsElapsed();
+            });
+        });
+
+        reportThreaded(elapsed, NUM_ALLOCS, rssBefore);
+    }
+
+    Q_NEVER_INLINE void benchTraceReplay_data()
+    {
+        QTest::addColumn<AllocatorBackend>("backend");
+        QTest::addColumn<QString>("trace");
+        QTest::addColumn<int>("threads");
+
+        const QStringList files = QString::fromLocal8Bit(qgetenv("BENCH_ALLOC_TRACES")).split(QLatin1Char(','), QString::SkipEmptyParts);
+        for (AllocatorBackend backend : ALLOCATOR_BACKENDS) {
+            for (const char* generated : {"lognormal", "small"}) {
+                foreach (int threads, threadCounts()) {
+                    const std::string name = backendName(backend) + ('/' + std::string(generated) + '/' + std::to_string(threads));
+                    QTest::newRow(name.data()) << backend << QString::fromLatin1(generated) << threads;
+                }
+            }
+            foreach (const QString& file, files) {
+                const std::string name = backendName(backend) + ('/' + QFileInfo(file).fileName().toStdString());
+                QTest::newRow(name.data()) << backend << file << 0;
+            }
+        }
+    }
+
+    // bench the replay of allocation traces with interleaved lifetimes
+    Q_NEVER_INLINE void benchTraceReplay()
+    {
+        QFETCH(AllocatorBackend, backend);
+        QFETCH(QString, trace);
+        QFETCH(int, threads);
+
+        AllocationTrace allocations;
+        if (trace == QLatin1String("lognormal")) {
+            allocations = generateLogNormalTrace(TRACE_EVENTS, threads);
+        } else if (trace == QLatin1String("small")) {
+            allocations = generateSmallHeavyTrace(TRACE_EVENTS, threads);
+        } else {
+            QVERIFY(allocations.load(trace));
+            threads = allocations.numThreads();
+        }
+
+        std::vector<std::vector<ReplayOperation>> operations(threads);
+        std::vector<std::vector<void*>> pointers(threads);
+        std::vector<size_t> ops(threads);
+        quint64 peakLiveBytes = 0;
+        for (int thread = 0; thread < threads; ++thread) {
+            operations[thread] = replayOperations(allocations, thread);
+            // every allocation has a matching free
+            pointers[thread].resize(operations[thread].size() / 2);
+            ops[thread] = operations[thread].size();
+            peakLiveBytes += allocations.peakLiveBytes(thread);
+        }
+        std::vector<qint64> elapsed(threads);
+        const qint64 rssBefore = residentSetSize();
+
+        withAllocator(backend, [&](auto allocator) {
+            runThreads(threads, [&](int thread) {
+                QElapsedTimer timer;
+                timer.start();
+                replay(operations[thread], pointers[thread], allocator);
+                elapsed[thread] = timer.nsecsElapsed();
+            });
+        });
+
+        qDebug("peak live memory of the trace: %llu KiB", peakLiveBytes / 1024);
+        reportThreaded(elapsed, ops, rssBefore);
+    }
 };
 
-QTEST_MAIN(BenchAlloc)
+BENCH_QT_MAIN(BenchAlloc)
 
 #include "bench_alloc.moc"
@@ -1,10 +1,13 @@
 TEMPLATE = app
 
 QT += testlib widgets
-CONFIG += c++11 testcase release
+CONFIG += c++14 testcase release
 
 linux|mac {
     QMAKE_CXXFLAGS += -g
 }
 
+HEADERS = allocators.h \
+          allocationtrace.h
+
 SOURCES = bench_alloc.cpp
\ No newline at end of file
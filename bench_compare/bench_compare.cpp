@@ -0,0 +1,317 @@
+/**
+ *
+ * Copyright (C) 2015 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com, author Milian Wolff <milian.wolff@kdab.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+
+#include <cmath>
+#include <cstdio>
+
+namespace {
+
+struct Samples
+{
+    QVector<double> baseline;
+    QVector<double> candidate;
+};
+
+// the key identifying a result across runs
+QString resultKey(const QString& testCase, const QJsonObject& result)
+{
+    return testCase + QLatin1String("::") + result.value(QLatin1String("function")).toString()
+         + QLatin1Char('(') + result.value(QLatin1String("tag")).toString() + QLatin1String(") ")
+         + result.value(QLatin1String("metric")).toString();
+}
+
+// throughput metrics get better when they go up, everything else when it goes down
+bool higherIsBetter(const QString& key)
+{
+    return key.endsWith(QLatin1String("PerSecond"));
+}
+
+/**
+ * Add the results of the JSON report at @p path to @p samples.
+ *
+ * @p baseline selects whether they are added to the baseline or candidate samples
+ * and @p metadata receives the metadata of the report.
+ */
+bool loadReport(const QString& path, bool baseline, QMap<QString, Samples>* samples, QJsonObject* metadata)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        fprintf(stderr, "failed to open %s: %s\n", qPrintable(path), qPrintable(file.errorString()));
+        return false;
+    }
+    QJsonParseError error;
+    const QJsonObject root = QJsonDocument::fromJson(file.readAll(), &error).object();
+    if (error.error != QJsonParseError::NoError) {
+        fprintf(stderr, "failed to parse %s: %s\n", qPrintable(path), qPrintable(error.errorString()));
+        return false;
+    }
+
+    *metadata = root.value(QLatin1String("metadata")).toObject();
+    const QString testCase = root.value(QLatin1String("testCase")).toString();
+    foreach (const QJsonValue& value, root.value(QLatin1String("results")).toArray()) {
+        const QJsonObject result = value.toObject();
+        auto& entry = (*samples)[resultKey(testCase, result)];
+        auto& values = baseline ? entry.baseline : entry.candidate;
+        // results measured with BenchStats::measure bring their own samples
+        const QJsonArray stats = result.value(QLatin1String("stats")).toObject().value(QLatin1String("samples")).toArray();
+        if (stats.isEmpty()) {
+            values << result.value(QLatin1String("value")).toDouble();
+        } else {
+            foreach (const QJsonValue& sample, stats) {
+                values << sample.toDouble();
+            }
+        }
+    }
+    return true;
+}
+
+double mean(const QVector<double>& values)
+{
+    double sum = 0;
+    foreach (double value, values) {
+        sum += value;
+    }
+    return sum / values.size();
+}
+
+double variance(const QVector<double>& values)
+{
+    const double average = mean(values);
+    double sum = 0;
+    foreach (double value, values) {
+        sum += (value - average) * (value - average);
+    }
+    return sum / (values.size() - 1);
+}
+
+// continued fraction for the incomplete beta function, see Numerical Recipes 6.4
+double betaContinuedFraction(double a, double b, double x)
+{
+    const int MAX_ITERATIONS = 300;
+    const double EPSILON = 3E-14;
+    const double MIN_VALUE = 1E-300;
+
+    const double qab = a + b;
+    const double qap = a + 1;
+    const double qam = a - 1;
+    double c = 1;
+    double d = 1 - qab * x / qap;
+    if (std::fabs(d) < MIN_VALUE) {
+        d = MIN_VALUE;
+    }
+    d = 1 / d;
+    double h = d;
+    for (int m = 1; m <= MAX_ITERATIONS; ++m) {
+        const int m2 = 2 * m;
+        double aa = m * (b - m) * x / ((qam + m2) * (a + m2));
+        d = 1 + aa * d;
+        if (std::fabs(d) < MIN_VALUE) {
+            d = MIN_VALUE;
+        }
+        c = 1 + aa / c;
+        if (std::fabs(c) < MIN_VALUE) {
+            c = MIN_VALUE;
+        }
+        d = 1 / d;
+        h *= d * c;
+        aa = -(a + m) * (qab + m) * x / ((a + m2) * (qap + m2));
+        d = 1 + aa * d;
+        if (std::fabs(d) < MIN_VALUE) {
+            d = MIN_VALUE;
+        }
+        c = 1 + aa / c;
+        if (std::fabs(c) < MIN_VALUE) {
+            c = MIN_VALUE;
+        }
+        d = 1 / d;
+        const double delta = d * c;
+        h *= delta;
+        if (std::fabs(delta - 1) < EPSILON) {
+            break;
+        }
+    }
+    return h;
+}
+
+// the regularized incomplete beta function I_x(a, b)
+double incompleteBeta(double a, double b, double x)
+{
+    if (x <= 0) {
+        return 0;
+    } else if (x >= 1) {
+        return 1;
+    }
+    const double front = std::exp(std::lgamma(a + b) - std::lgamma(a) - std::lgamma(b)
+                                  + a * std::log(x) + b * std::log(1 - x));
+    if (x < (a + 1) / (a + b + 2)) {
+        return front * betaContinuedFraction(a, b, x) / a;
+    }
+    return 1 - front * betaContinuedFraction(b, a, 1 - x) / b;
+}
+
+// the two-sided p-value of Welch's t-test for the means of @p a and @p b being equal
+double welchPValue(const QVector<double>& a, const QVector<double>& b)
+{
+    const double va = variance(a) / a.size();
+    const double vb = variance(b) / b.size();
+    if (va + vb == 0) {
+        return mean(a) == mean(b) ? 1 : 0;
+    }
+    const double t = (mean(a) - mean(b)) / std::sqrt(va + vb);
+    const double df = (va + vb) * (va + vb) / (va * va / (a.size() - 1) + vb * vb / (b.size() - 1));
+    return incompleteBeta(df / 2, 0.5, df / (df + t * t));
+}
+
+}
+
+/**
+ * Compares the JSON reports written by the benchmarks, see report.h, and flags
+ * significant regressions.
+ *
+ * Every report file contributes one sample per result, or all of its samples
+ * for results measured with BenchStats::measure. With two or more samples on
+ * each side, a result only counts as regression when the change exceeds the
+ * threshold and Welch's t-test says it is significant. With a single sample on
+ * either side, only the threshold is applied.
+ *
+ * The exit code is 1 when regressions were found, such that this can be used
+ * to gate e.g. Qt upgrades in CI.
+ */
+int main(int argc, char** argv)
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Compare benchmark reports and flag regressions."));
+    parser.addHelpOption();
+    const QCommandLineOption baselineOption({QStringLiteral("b"), QStringLiteral("baseline")},
+                                            QStringLiteral("A baseline report, can be passed multiple times."),
+                                            QStringLiteral("file"));
+    const QCommandLineOption candidateOption({QStringLiteral("c"), QStringLiteral("candidate")},
+                                             QStringLiteral("A candidate report, can be passed multiple times."),
+                                             QStringLiteral("file"));
+    const QCommandLineOption thresholdOption({QStringLiteral("t"), QStringLiteral("threshold")},
+                                             QStringLiteral("Minimum relative change in percent to report (default: 5)."),
+                                             QStringLiteral("percent"), QStringLiteral("5"));
+    const QCommandLineOption alphaOption({QStringLiteral("a"), QStringLiteral("alpha")},
+                                         QStringLiteral("Significance level of the t-test (default: 0.05)."),
+                                         QStringLiteral("alpha"), QStringLiteral("0.05"));
+    parser.addOption(baselineOption);
+    parser.addOption(candidateOption);
+    parser.addOption(thresholdOption);
+    parser.addOption(alphaOption);
+    parser.addPositionalArgument(QStringLiteral("baseline"), QStringLiteral("Shorthand for --baseline."), QStringLiteral("[baseline]"));
+    parser.addPositionalArgument(QStringLiteral("candidate"), QStringLiteral("Shorthand for --candidate."), QStringLiteral("[candidate]"));
+    parser.process(app);
+
+    QStringList baselines = parser.values(baselineOption);
+    QStringList candidates = parser.values(candidateOption);
+    const QStringList positional = parser.positionalArguments();
+    if (positional.size() == 2) {
+        baselines << positional.at(0);
+        candidates << positional.at(1);
+    } else if (!positional.isEmpty()) {
+        parser.showHelp(2);
+    }
+    if (baselines.isEmpty() || candidates.isEmpty()) {
+        parser.showHelp(2);
+    }
+    const double threshold = parser.value(thresholdOption).toDouble() / 100.;
+    const double alpha = parser.value(alphaOption).toDouble();
+
+    QMap<QString, Samples> samples;
+    QJsonObject baselineMetadata;
+    QJsonObject candidateMetadata;
+    foreach (const QString& path, baselines) {
+        if (!loadReport(path, true, &samples, &baselineMetadata)) {
+            return 2;
+        }
+    }
+    foreach (const QString& path, candidates) {
+        if (!loadReport(path, false, &samples, &candidateMetadata)) {
+            return 2;
+        }
+    }
+
+    for (const char* key : {"host", "cpu", "compiler", "qtVersion"}) {
+        const QString name = QString::fromLatin1(key);
+        const QString before = baselineMetadata.value(name).toVariant().toString();
+        const QString after = candidateMetadata.value(name).toVariant().toString();
+        if (before != after) {
+            printf("note: %s differs: %s -> %s\n", key, qPrintable(before), qPrintable(after));
+        }
+    }
+
+    int regressions = 0;
+    int improvements = 0;
+    for (auto it = samples.constBegin(); it != samples.constEnd(); ++it) {
+        const Samples& entry = it.value();
+        if (entry.baseline.isEmpty() || entry.candidate.isEmpty()) {
+            continue;
+        }
+        const double before = mean(entry.baseline);
+        const double after = mean(entry.candidate);
+        if (before == 0) {
+            continue;
+        }
+        const double change = (after - before) / before;
+        if (std::fabs(change) < threshold) {
+            continue;
+        }
+
+        QString significance = QStringLiteral("single run");
+        if (entry.baseline.size() >= 2 && entry.candidate.size() >= 2) {
+            const double p = welchPValue(entry.baseline, entry.candidate);
+            if (p >= alpha) {
+                continue;
+            }
+            significance = QStringLiteral("p=%1").arg(p, 0, 'g', 3);
+        }
+
+        const bool worse = higherIsBetter(it.key()) ? change < 0 : change > 0;
+        (worse ? regressions : improvements)++;
+        printf("%-11s %s: %g -> %g (%+.1f%%, %s)\n", worse ? "REGRESSION" : "improvement",
+               qPrintable(it.key()), before, after, change * 100, qPrintable(significance));
+    }
+
+    printf("%d regressions, %d improvements\n", regressions, improvements);
+    return regressions ? 1 : 0;
+}
@@ -0,0 +1,7 @@
+TEMPLATE = app
+
+QT = core
+CONFIG += c++11 console release
+CONFIG -= app_bundle
+
+SOURCES = bench_compare.cpp
\ No newline at end of file
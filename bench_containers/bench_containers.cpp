@@ -36,8 +36,16 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <numeric>
+#include <random>
+#include <type_traits>
 
 #include "../util.h"
+#include "../report.h"
+#include "../stats.h"
+#include "flathash.h"
+#include "flatmap.h"
+#include "stringhash.h"
 
 namespace {
 
@@ -63,6 +71,309 @@ struct BarMovable
     double b;
 };
 
+/**
+ * The keys to look up in the hash lookup benchmarks, for a map with the keys
+ * 0 to @p keys - 1.
+ *
+ * "sequential" looks up all keys in order, "random" in random order and
+ * "miss" looks up nine keys which are not in the map for every one that is.
+ */
+std::vector<size_t> makeLookups(size_t keys, const QByteArray& lookup)
+{
+    std::vector<size_t> lookups(keys);
+    for (size_t i = 0; i < keys; ++i) {
+        lookups[i] = (lookup == "miss" && i % 10) ? keys + i : i;
+    }
+    if (lookup != "sequential") {
+        std::shuffle(lookups.begin(), lookups.end(), std::mt19937(42));
+    }
+    return lookups;
+}
+
+void addLookupRows(std::initializer_list<const char*> lookups)
+{
+    QTest::addColumn<size_t>("keys");
+    QTest::addColumn<QByteArray>("lookup");
+    for (size_t keys : {10000, 100000, 1000000, 10000000}) {
+        for (const char* lookup : lookups) {
+            const std::string name = std::to_string(keys) + '/' + lookup;
+            QTest::newRow(name.data()) << keys << QByteArray(lookup);
+        }
+    }
+}
+
+// operator[] would insert the missing keys, thus no misses for the index benchmarks
+void indexLookup_data()
+{
+    addLookupRows({"sequential", "random"});
+}
+
+void containsLookup_data()
+{
+    addLookupRows({"sequential", "random", "miss"});
+}
+
+template<typename Map>
+void fillHash(Map& map, size_t keys, size_t offset)
+{
+    map.reserve(keys);
+    for (size_t i = 0; i < keys; ++i) {
+        map[i] = i + offset;
+    }
+}
+
+// the ordered map keys are spread out such that range queries can start in between them
+const size_t MAP_KEY_STRIDE = 16;
+// the number of entries a range query visits
+const size_t MAP_RANGE_LENGTH = 100;
+const size_t MAP_RANGES = 10000;
+
+void orderedMap_data()
+{
+    QTest::addColumn<size_t>("keys");
+    for (size_t keys : {1000, 10000, 100000, 1000000, 10000000}) {
+        QTest::newRow(std::to_string(keys).data()) << keys;
+    }
+}
+
+/**
+ * The keys 0, MAP_KEY_STRIDE, 2 * MAP_KEY_STRIDE, ... in random order.
+ *
+ * Use a different @p seed for the lookups than for the insertion, the nodes
+ * of a QMap are allocated in insertion order and looking them up in the same
+ * order would hit the cache far more often than in practice.
+ */
+std::vector<size_t> makeMapKeys(size_t keys, unsigned seed)
+{
+    std::vector<size_t> mapKeys(keys);
+    for (size_t i = 0; i < keys; ++i) {
+        mapKeys[i] = i * MAP_KEY_STRIDE;
+    }
+    std::shuffle(mapKeys.begin(), mapKeys.end(), std::mt19937(seed));
+    return mapKeys;
+}
+
+// random start keys for the range queries, which mostly fall in between the map keys
+std::vector<size_t> makeRangeStarts(size_t keys)
+{
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<size_t> distribution(0, keys * MAP_KEY_STRIDE - 1);
+    std::vector<size_t> starts(MAP_RANGES);
+    for (auto& start : starts) {
+        start = distribution(generator);
+    }
+    return starts;
+}
+
+QMap<size_t, size_t> makeQMap(const std::vector<size_t>& keys)
+{
+    QMap<size_t, size_t> map;
+    for (size_t key : keys) {
+        map.insert(key, key);
+    }
+    return map;
+}
+
+// commits after every batch, which merges each batch into the sorted entries of the previous ones
+template<FlatMapSearch Search>
+FlatMap<size_t, size_t, Search> makeFlatMap(const std::vector<size_t>& keys, size_t batches = 1)
+{
+    FlatMap<size_t, size_t, Search> map;
+    const size_t batchSize = (keys.size() + batches - 1) / batches;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        map.insert(keys[i], keys[i]);
+        if ((i + 1) % batchSize == 0) {
+            map.commit();
+        }
+    }
+    map.commit();
+    return map;
+}
+
+template<FlatMapSearch Search>
+void benchFlatMapLookup()
+{
+    QFETCH(size_t, keys);
+    const auto map = makeFlatMap<Search>(makeMapKeys(keys, 42));
+    const std::vector<size_t> lookups = makeMapKeys(keys, 7);
+    QBENCHMARK {
+        for (size_t key : lookups) {
+            auto value = map.value(key);
+            escape(&value);
+        }
+    }
+}
+
+// the number of keys hashed per sample of the string hash benchmarks
+const int STRING_HASH_BATCH = 1000;
+
+/**
+ * @p count distinct identifier like keys of @p length Latin-1 characters:
+ * random letters and digits, followed by an underscore and the index of the
+ * key in base 36.
+ */
+QVector<QByteArray> makeStringKeys(int count, int length)
+{
+    const char alphabet[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+    std::mt19937 generator(42);
+    QVector<QByteArray> keys;
+    keys.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        const QByteArray suffix = '_' + QByteArray::number(i, 36);
+        QByteArray key(length - suffix.size(), Qt::Uninitialized);
+        for (char& c : key) {
+            c = alphabet[generator() % (sizeof(alphabet) - 1)];
+        }
+        keys << key + suffix;
+    }
+    return keys;
+}
+
+/**
+ * The keys of the string hash benchmarks in all key types, and the lookups:
+ * the same keys in random order as views into one text, like a parser would
+ * produce them.
+ */
+struct StringKeys
+{
+    StringKeys(int count, int length)
+        : bytes(makeStringKeys(count, length))
+    {
+        for (const QByteArray& key : bytes) {
+            strings << QString::fromLatin1(key);
+            latin1 << QLatin1String(key);
+        }
+
+        std::vector<int> order(count);
+        std::iota(order.begin(), order.end(), 0);
+        std::shuffle(order.begin(), order.end(), std::mt19937(7));
+        latin1Text.reserve(count * length);
+        for (int index : order) {
+            latin1Text += bytes[index];
+        }
+        utf16Text = QString::fromLatin1(latin1Text);
+        for (int i = 0; i < count; ++i) {
+            latin1Lookups.push_back(QLatin1String(latin1Text.constData() + i * length, length));
+            utf16Lookups.push_back(QStringView(utf16Text.constData() + i * length, length));
+        }
+    }
+
+    QVector<QByteArray> bytes;
+    QVector<QString> strings;
+    QVector<QLatin1String> latin1;
+
+    QByteArray latin1Text;
+    QString utf16Text;
+    std::vector<QLatin1String> latin1Lookups;
+    std::vector<QStringView> utf16Lookups;
+
+private:
+    Q_DISABLE_COPY(StringKeys)
+};
+
+/**
+ * Call @p func with the keys and lookups of @p keyType: maps with QString
+ * keys get looked up with QStringView, or with QLatin1String for
+ * "QString/latin1". Maps with QByteArray or QLatin1String keys get looked up
+ * with QLatin1String.
+ */
+template<typename Func>
+void withStringKeys(const StringKeys& keys, const QByteArray& keyType, Func func)
+{
+    if (keyType == "QString") {
+        func(keys.strings, keys.utf16Lookups);
+    } else if (keyType == "QString/latin1") {
+        func(keys.strings, keys.latin1Lookups);
+    } else if (keyType == "QByteArray") {
+        func(keys.bytes, keys.latin1Lookups);
+    } else {
+        func(keys.latin1, keys.latin1Lookups);
+    }
+}
+
+// the type of the keys passed to a withStringKeys() callback
+template<typename Keys>
+using StringKeyType = typename std::decay_t<Keys>::value_type;
+
+template<typename Hash>
+void benchStringHash(Hash hash)
+{
+    QFETCH(QByteArray, keyType);
+    QFETCH(int, length);
+    const StringKeys keys(STRING_HASH_BATCH, length);
+    withStringKeys(keys, keyType, [&](const auto& mapKeys, const auto& /*lookups*/) {
+        // the throughput is in bytes of the keys, i.e. twice the characters for QString
+        const int charSize = std::is_same<StringKeyType<decltype(mapKeys)>, QString>::value ? sizeof(QChar) : 1;
+        BenchStats::reportThroughput(BenchStats::measure(qint64(mapKeys.size()) * length * charSize, [&] {
+            size_t sum = 0;
+            for (const auto& key : mapKeys) {
+                sum += hash(key);
+            }
+            escape(&sum);
+        }));
+    });
+}
+
+template<typename Func>
+void withStringLookups(Func func)
+{
+    QFETCH(QByteArray, keyType);
+    QFETCH(int, keys);
+    QFETCH(int, length);
+    const StringKeys stringKeys(keys, length);
+    withStringKeys(stringKeys, keyType, func);
+}
+
+// the temporary key for a lookup in a map which can only be looked up with its key type
+inline QString toKey(const QString* /*type*/, QStringView lookup)
+{
+    return lookup.toString();
+}
+
+inline QString toKey(const QString* /*type*/, QLatin1String lookup)
+{
+    return QString(lookup);
+}
+
+inline QByteArray toKey(const QByteArray* /*type*/, QLatin1String lookup)
+{
+    return QByteArray(lookup.data(), lookup.size());
+}
+
+inline QLatin1String toKey(const QLatin1String* /*type*/, QLatin1String lookup)
+{
+    return lookup;
+}
+
+/**
+ * Benchmark @p lookup, which returns the value of a key or -1, for all of
+ * @p lookups, after verifying that all of them are found.
+ */
+template<typename Lookups, typename Lookup>
+void benchStringLookup(const Lookups& lookups, Lookup lookup)
+{
+    for (const auto& key : lookups) {
+        if (lookup(key) == -1) {
+            QFAIL("lookup failed");
+        }
+    }
+    QBENCHMARK {
+        for (const auto& key : lookups) {
+            auto value = lookup(key);
+            escape(&value);
+        }
+    }
+}
+
+template<typename Map, typename Keys>
+void fillStringMap(Map& map, const Keys& keys)
+{
+    map.reserve(keys.size());
+    for (int i = 0; i < keys.size(); ++i) {
+        map.insert(keys[i], i);
+    }
+}
+
 }
 
 Q_DECLARE_TYPEINFO(BarMovable, Q_MOVABLE_TYPE);
@@ -82,6 +393,16 @@ class BenchContainers : public QObject
     Q_OBJECT
 
 private slots:
+    void init()
+    {
+        BenchReport::startPerfCounters();
+    }
+
+    void cleanup()
+    {
+        BenchReport::stopPerfCounters();
+    }
+
     // bar is too large and every node be allocated on the heap
     Q_NEVER_INLINE void benchQList()
     {
@@ -134,33 +455,62 @@ private slots:
         }
     }
 
+    Q_NEVER_INLINE void benchQHashIndex_data()
+    {
+        indexLookup_data();
+    }
+
     Q_NEVER_INLINE void benchQHashIndex()
     {
+        QFETCH(size_t, keys);
+        QFETCH(QByteArray, lookup);
         QHash<size_t, size_t> map;
-        map.reserve(NUM_ALLOCS);
-        for(size_t i = 0; i < NUM_ALLOCS; ++i) {
-            map[i] = i;
+        fillHash(map, keys, 0);
+        const std::vector<size_t> lookups = makeLookups(keys, lookup);
+        QBENCHMARK {
+            for (size_t key : lookups) {
+                auto value = map[key];
+                escape(&value);
+            }
         }
-        auto keys = map.keys();
-        std::random_shuffle(keys.begin(), keys.end());
+    }
+
+    Q_NEVER_INLINE void benchFlatHashIndex_data()
+    {
+        indexLookup_data();
+    }
+
+    Q_NEVER_INLINE void benchFlatHashIndex()
+    {
+        QFETCH(size_t, keys);
+        QFETCH(QByteArray, lookup);
+        FlatHash<size_t, size_t> map;
+        fillHash(map, keys, 0);
+        const std::vector<size_t> lookups = makeLookups(keys, lookup);
         QBENCHMARK {
-            foreach(auto key, keys) {
+            for (size_t key : lookups) {
                 auto value = map[key];
                 escape(&value);
             }
         }
     }
 
+    Q_NEVER_INLINE void benchQMapIndex_data()
+    {
+        indexLookup_data();
+    }
+
     Q_NEVER_INLINE void benchQMapIndex()
     {
+        QFETCH(size_t, keys);
+        QFETCH(QByteArray, lookup);
         QMap<size_t, size_t> map;
-        for(size_t i = 0; i < NUM_ALLOCS; ++i) {
+        for(size_t i = 0; i < keys; ++i) {
             map[i] = i;
         }
-        auto keys = map.keys();
-        std::random_shuffle(keys.begin(), keys.end());
+        const std::vector<size_t> lookups = makeLookups(keys, lookup);
         QBENCHMARK {
-            foreach(auto key, keys) {
+            for (size_t key : lookups) {
                 auto value = map[key];
                 escape(&value);
             }
@@ -216,40 +566,382 @@ private slots:
         }
     }
 
+    Q_NEVER_INLINE void benchQHashContainsLookup_data()
+    {
+        containsLookup_data();
+    }
+
     Q_NEVER_INLINE void benchQHashContainsLookup()
     {
+        QFETCH(size_t, keys);
+        QFETCH(QByteArray, lookup);
         QHash<size_t, size_t> map;
-        map.reserve(NUM_ALLOCS);
-        for(size_t i = 0; i < NUM_ALLOCS; ++i) {
-            map[i] = i + 1; // assume zero is invalid
+        fillHash(map, keys, 1); // assume zero is invalid
+        const std::vector<size_t> lookups = makeLookups(keys, lookup);
+        QBENCHMARK {
+            for (size_t key : lookups) {
+                size_t value = 0;
+                if (map.contains(key)) {
+                    value = map[key];
+                }
+                escape(&value);
+            }
         }
+    }
+
+    Q_NEVER_INLINE void benchFlatHashContainsLookup_data()
+    {
+        containsLookup_data();
+    }
+
+    Q_NEVER_INLINE void benchFlatHashContainsLookup()
+    {
+        QFETCH(size_t, keys);
+        QFETCH(QByteArray, lookup);
+        FlatHash<size_t, size_t> map;
+        fillHash(map, keys, 1); // assume zero is invalid
+        const std::vector<size_t> lookups = makeLookups(keys, lookup);
         QBENCHMARK {
-            for(size_t i = 0; i < NUM_ALLOCS; ++i) {
+            for (size_t key : lookups) {
                 size_t value = 0;
-                if (map.contains(i)) {
-                    value = map[i];
+                if (map.contains(key)) {
+                    value = map[key];
                 }
                 escape(&value);
             }
         }
     }
 
+    Q_NEVER_INLINE void benchQHashValueLookup_data()
+    {
+        containsLookup_data();
+    }
+
     Q_NEVER_INLINE void benchQHashValueLookup()
     {
+        QFETCH(size_t, keys);
+        QFETCH(QByteArray, lookup);
         QHash<size_t, size_t> map;
-        map.reserve(NUM_ALLOCS);
-        for(size_t i = 0; i < NUM_ALLOCS; ++i) {
-            map[i] = i + 1; // assume zero is invalid
+        fillHash(map, keys, 1); // assume zero is invalid
+        const std::vector<size_t> lookups = makeLookups(keys, lookup);
+        QBENCHMARK {
+            for (size_t key : lookups) {
+                size_t value = map.value(key, 0);
+                escape(&value);
+            }
         }
+    }
+
+    Q_NEVER_INLINE void benchFlatHashValueLookup_data()
+    {
+        containsLookup_data();
+    }
+
+    Q_NEVER_INLINE void benchFlatHashValueLookup()
+    {
+        QFETCH(size_t, keys);
+        QFETCH(QByteArray, lookup);
+        FlatHash<size_t, size_t> map;
+        fillHash(map, keys, 1); // assume zero is invalid
+        const std::vector<size_t> lookups = makeLookups(keys, lookup);
         QBENCHMARK {
-            for(size_t i = 0; i < NUM_ALLOCS; ++i) {
-                size_t value = map.value(i, 0);
+            for (size_t key : lookups) {
+                size_t value = map.value(key, 0);
+                escape(&value);
+            }
+        }
+    }
+
+    Q_NEVER_INLINE void benchQMapBuild_data()
+    {
+        orderedMap_data();
+    }
+
+    Q_NEVER_INLINE void benchQMapBuild()
+    {
+        QFETCH(size_t, keys);
+        const std::vector<size_t> mapKeys = makeMapKeys(keys, 42);
+        QBENCHMARK {
+            auto map = makeQMap(mapKeys);
+            escape(&map);
+        }
+    }
+
+    Q_NEVER_INLINE void benchFlatMapBuild_data()
+    {
+        QTest::addColumn<size_t>("keys");
+        QTest::addColumn<size_t>("batches");
+        for (size_t keys : {1000, 10000, 100000, 1000000, 10000000}) {
+            for (size_t batches : {1, 10}) {
+                const std::string name = std::to_string(keys) + '/' + std::to_string(batches);
+                QTest::newRow(name.data()) << keys << batches;
+            }
+        }
+    }
+
+    Q_NEVER_INLINE void benchFlatMapBuild()
+    {
+        QFETCH(size_t, keys);
+        QFETCH(size_t, batches);
+        const std::vector<size_t> mapKeys = makeMapKeys(keys, 42);
+        QBENCHMARK {
+            auto map = makeFlatMap<FlatMapSearch::Eytzinger>(mapKeys, batches);
+            escape(&map);
+        }
+    }
+
+    Q_NEVER_INLINE void benchQMapLookup_data()
+    {
+        orderedMap_data();
+    }
+
+    Q_NEVER_INLINE void benchQMapLookup()
+    {
+        QFETCH(size_t, keys);
+        const auto map = makeQMap(makeMapKeys(keys, 42));
+        const std::vector<size_t> lookups = makeMapKeys(keys, 7);
+        QBENCHMARK {
+            for (size_t key : lookups) {
+                auto value = map.value(key);
+                escape(&value);
+            }
+        }
+    }
+
+    Q_NEVER_INLINE void benchFlatMapLookupBranchless_data()
+    {
+        orderedMap_data();
+    }
+
+    Q_NEVER_INLINE void benchFlatMapLookupBranchless()
+    {
+        benchFlatMapLookup<FlatMapSearch::Branchless>();
+    }
+
+    Q_NEVER_INLINE void benchFlatMapLookupEytzinger_data()
+    {
+        orderedMap_data();
+    }
+
+    Q_NEVER_INLINE void benchFlatMapLookupEytzinger()
+    {
+        benchFlatMapLookup<FlatMapSearch::Eytzinger>();
+    }
+
+    Q_NEVER_INLINE void benchQMapRange_data()
+    {
+        orderedMap_data();
+    }
+
+    Q_NEVER_INLINE void benchQMapRange()
+    {
+        QFETCH(size_t, keys);
+        const auto map = makeQMap(makeMapKeys(keys, 42));
+        const std::vector<size_t> starts = makeRangeStarts(keys);
+        QBENCHMARK {
+            for (size_t start : starts) {
+                const size_t stop = start + MAP_RANGE_LENGTH * MAP_KEY_STRIDE;
+                for (auto it = map.lowerBound(start), end = map.end(); it != end && it.key() < stop; ++it) {
+                    auto value = it.value();
+                    escape(&value);
+                }
+            }
+        }
+    }
+
+    Q_NEVER_INLINE void benchFlatMapRange_data()
+    {
+        orderedMap_data();
+    }
+
+    Q_NEVER_INLINE void benchFlatMapRange()
+    {
+        QFETCH(size_t, keys);
+        const auto map = makeFlatMap<FlatMapSearch::Eytzinger>(makeMapKeys(keys, 42));
+        const std::vector<size_t> starts = makeRangeStarts(keys);
+        QBENCHMARK {
+            for (size_t start : starts) {
+                const size_t stop = start + MAP_RANGE_LENGTH * MAP_KEY_STRIDE;
+                for (int i = map.lowerBound(start), end = map.size(); i != end && map.keyAt(i) < stop; ++i) {
+                    auto value = map.valueAt(i);
+                    escape(&value);
+                }
+            }
+        }
+    }
+
+    Q_NEVER_INLINE void benchQMapOrdered_data()
+    {
+        orderedMap_data();
+    }
+
+    Q_NEVER_INLINE void benchQMapOrdered()
+    {
+        QFETCH(size_t, keys);
+        const auto map = makeQMap(makeMapKeys(keys, 42));
+        QBENCHMARK {
+            for (auto it = map.begin(), end = map.end(); it != end; ++it) {
+                auto key = it.key();
+                auto value = it.value();
+                escape(&key);
+                escape(&value);
+            }
+        }
+    }
+
+    Q_NEVER_INLINE void benchFlatMapOrdered_data()
+    {
+        orderedMap_data();
+    }
+
+    Q_NEVER_INLINE void benchFlatMapOrdered()
+    {
+        QFETCH(size_t, keys);
+        const auto map = makeFlatMap<FlatMapSearch::Eytzinger>(makeMapKeys(keys, 42));
+        QBENCHMARK {
+            for (int i = 0, end = map.size(); i != end; ++i) {
+                auto key = map.keyAt(i);
+                auto value = map.valueAt(i);
+                escape(&key);
                 escape(&value);
             }
         }
     }
+
+    Q_NEVER_INLINE void benchStringHash_data()
+    {
+        QTest::addColumn<QByteArray>("keyType");
+        QTest::addColumn<int>("length");
+        for (const char* keyType : {"QString", "QByteArray", "QLatin1String"}) {
+            for (int length : {8, 16, 32, 64, 256}) {
+                const std::string name = std::string(keyType) + '/' + std::to_string(length);
+                QTest::newRow(name.data()) << QByteArray(keyType) << length;
+            }
+        }
+    }
+
+    Q_NEVER_INLINE void benchStringHashQt_data()
+    {
+        benchStringHash_data();
+    }
+
+    // with the seed of QHash, which enables the CRC32 based qHash on CPUs with SSE 4.2
+    Q_NEVER_INLINE void benchStringHashQt()
+    {
+        benchStringHash([](const auto& key) {
+            return qHash(key, qGlobalQHashSeed());
+        });
+    }
+
+    Q_NEVER_INLINE void benchStringHashWyhash_data()
+    {
+        benchStringHash_data();
+    }
+
+    Q_NEVER_INLINE void benchStringHashWyhash()
+    {
+        benchStringHash([](const auto& key) {
+            return StringHasher<std::decay_t<decltype(key)>>()(key);
+        });
+    }
+
+    Q_NEVER_INLINE void benchStringLookup_data()
+    {
+        QTest::addColumn<QByteArray>("keyType");
+        QTest::addColumn<int>("keys");
+        QTest::addColumn<int>("length");
+        for (const char* keyType : {"QString", "QString/latin1", "QByteArray", "QLatin1String"}) {
+            for (int keys : {10000, 1000000}) {
+                for (int length : {8, 24, 64}) {
+                    const std::string name = std::string(keyType) + '/' + std::to_string(keys) + '/' + std::to_string(length);
+                    QTest::newRow(name.data()) << QByteArray(keyType) << keys << length;
+                }
+            }
+        }
+    }
+
+    Q_NEVER_INLINE void benchStringLookupQHash_data()
+    {
+        benchStringLookup_data();
+    }
+
+    // QHash can only be looked up with its key type, thus every lookup creates a temporary key
+    Q_NEVER_INLINE void benchStringLookupQHash()
+    {
+        withStringLookups([](const auto& mapKeys, const auto& lookups) {
+            using Key = StringKeyType<decltype(mapKeys)>;
+            QHash<Key, int> map;
+            fillStringMap(map, mapKeys);
+            benchStringLookup(lookups, [&](const auto& lookup) {
+                return map.value(toKey(static_cast<const Key*>(nullptr), lookup), -1);
+            });
+        });
+    }
+
+    Q_NEVER_INLINE void benchStringLookupFlatHash_data()
+    {
+        benchStringLookup_data();
+    }
+
+    // like QHash, but with the table of FlatHash
+    Q_NEVER_INLINE void benchStringLookupFlatHash()
+    {
+        withStringLookups([](const auto& mapKeys, const auto& lookups) {
+            using Key = StringKeyType<decltype(mapKeys)>;
+            FlatHash<Key, int> map;
+            fillStringMap(map, mapKeys);
+            benchStringLookup(lookups, [&](const auto& lookup) {
+                return map.value(toKey(static_cast<const Key*>(nullptr), lookup), -1);
+            });
+        });
+    }
+
+    Q_NEVER_INLINE void benchStringLookupWyhash_data()
+    {
+        benchStringLookup_data();
+    }
+
+    // heterogeneous lookups, without temporary keys
+    Q_NEVER_INLINE void benchStringLookupWyhash()
+    {
+        withStringLookups([](const auto& mapKeys, const auto& lookups) {
+            using Key = StringKeyType<decltype(mapKeys)>;
+            FlatHash<Key, int, StringHasher<Key>, StringEqual> map;
+            fillStringMap(map, mapKeys);
+            benchStringLookup(lookups, [&](const auto& lookup) {
+                return map.value(lookup, -1);
+            });
+        });
+    }
+
+    Q_NEVER_INLINE void benchStringLookupPrecomputed_data()
+    {
+        benchStringLookup_data();
+    }
+
+    // the hashes of the lookups are computed up front, which leaves the cost of the table
+    Q_NEVER_INLINE void benchStringLookupPrecomputed()
+    {
+        withStringLookups([](const auto& mapKeys, const auto& lookups) {
+            using Key = StringKeyType<decltype(mapKeys)>;
+            using Hasher = StringHasher<Key>;
+            FlatHash<HashedString<Key>, int, HashedStringHasher, HashedStringEqual> map;
+            map.reserve(mapKeys.size());
+            for (int i = 0; i < mapKeys.size(); ++i) {
+                map.insert(hashedString<Hasher>(mapKeys[i]), i);
+            }
+            std::vector<HashedString<StringKeyType<decltype(lookups)>>> hashedLookups;
+            hashedLookups.reserve(lookups.size());
+            for (const auto& lookup : lookups) {
+                hashedLookups.push_back(hashedString<Hasher>(lookup));
+            }
+            benchStringLookup(hashedLookups, [&](const auto& lookup) {
+                return map.value(lookup, -1);
+            });
+        });
+    }
 };
 
-QTEST_GUILESS_MAIN(BenchContainers)
+BENCH_QT_GUILESS_MAIN(BenchContainers)
 
 #include "bench_containers.moc"
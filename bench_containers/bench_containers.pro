@@ -1,10 +1,14 @@
 TEMPLATE = app
 
 QT += testlib
-CONFIG += c++11 testcase release
+CONFIG += c++1z testcase release
 
 linux|mac {
     QMAKE_CXXFLAGS += -g
 }
 
+HEADERS = flathash.h \
+          flatmap.h \
+          stringhash.h
+
 SOURCES = bench_containers.cpp
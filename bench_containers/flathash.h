@@ -0,0 +1,458 @@
+/**
+ *
+ * Copyright (C) 2015 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com, author Milian Wolff <milian.wolff@kdab.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef BENCH_QT_FLATHASH_H
+#define BENCH_QT_FLATHASH_H
+
+#include <QHash>
+#include <QtGlobal>
+
+#include <cstring>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#if defined(Q_PROCESSOR_X86) && defined(__SSE2__)
+#include <immintrin.h>
+#define HAVE_FLATHASH_SIMD
+#endif
+
+/**
+ * The default hasher of FlatHash: qHash, followed by a multiplicative mix.
+ *
+ * The mix is needed as qHash of integers is the identity, while FlatHash
+ * takes the bucket from the low and the metadata from the high bits.
+ */
+template<typename Key>
+struct FlatHashHasher
+{
+    size_t operator()(const Key& key) const
+    {
+        const quint64 hash = static_cast<quint64>(qHash(key)) * Q_UINT64_C(0x9E3779B97F4A7C15);
+        return static_cast<size_t>(hash ^ (hash >> 32));
+    }
+};
+
+/**
+ * Only has a type member if both @p Hasher and @p KeyEqual are transparent,
+ * i.e. FlatHash can look up keys of type @p K without converting them to Key.
+ */
+template<typename K, typename Hasher, typename KeyEqual, typename = void>
+struct FlatHashLookupKey
+{
+};
+
+template<typename K, typename Hasher, typename KeyEqual>
+struct FlatHashLookupKey<K, Hasher, KeyEqual,
+                         std::void_t<typename Hasher::is_transparent, typename KeyEqual::is_transparent>>
+{
+    using type = K;
+};
+
+/**
+ * A hash map with open addressing in a single flat table, in the style of
+ * the Swiss tables of abseil.
+ *
+ * The slots are grouped by 16. Each slot has a control byte, which is either
+ * EMPTY, DELETED or the top 7 bits of the hash of its key. A lookup compares
+ * the control bytes of a whole group with the hash at once (SSE2) and only
+ * compares the keys of the matching slots. Groups are probed quadratically,
+ * until one with an EMPTY slot is found.
+ *
+ * The API follows QHash, but iterators and references are invalidated by
+ * any insertion, as the table gets rehashed. With a transparent Hasher and
+ * KeyEqual, which define is_transparent like the ones of std::unordered_map
+ * in C++20, the lookups also accept other key types, see stringhash.h.
+ */
+template<typename Key, typename T, typename Hasher = FlatHashHasher<Key>, typename KeyEqual = std::equal_to<Key>>
+class FlatHash
+{
+    struct Slot
+    {
+        Key key;
+        T value;
+    };
+
+public:
+    class const_iterator
+    {
+    public:
+        const Key& key() const
+        {
+            return m_hash->m_slots[m_index].key;
+        }
+
+        const T& value() const
+        {
+            return m_hash->m_slots[m_index].value;
+        }
+
+        const T& operator*() const
+        {
+            return value();
+        }
+
+        const_iterator& operator++()
+        {
+            m_index = m_hash->nextFull(m_index + 1);
+            return *this;
+        }
+
+        bool operator==(const const_iterator& other) const
+        {
+            return m_index == other.m_index;
+        }
+
+        bool operator!=(const const_iterator& other) const
+        {
+            return m_index != other.m_index;
+        }
+
+    private:
+        friend class FlatHash;
+
+        const_iterator(const FlatHash* hash, size_t index)
+            : m_hash(hash)
+            , m_index(index)
+        {
+        }
+
+        const FlatHash* m_hash;
+        size_t m_index;
+    };
+
+    FlatHash() = default;
+
+    FlatHash(const FlatHash& other)
+    {
+        reserve(other.size());
+        for (auto it = other.begin(), end = other.end(); it != end; ++it) {
+            insert(it.key(), it.value());
+        }
+    }
+
+    FlatHash& operator=(FlatHash other)
+    {
+        swap(other);
+        return *this;
+    }
+
+    ~FlatHash()
+    {
+        destroy();
+    }
+
+    void swap(FlatHash& other)
+    {
+        std::swap(m_control, other.m_control);
+        std::swap(m_slots, other.m_slots);
+        std::swap(m_capacity, other.m_capacity);
+        std::swap(m_size, other.m_size);
+        std::swap(m_deleted, other.m_deleted);
+    }
+
+    int size() const
+    {
+        return static_cast<int>(m_size);
+    }
+
+    bool isEmpty() const
+    {
+        return !m_size;
+    }
+
+    int capacity() const
+    {
+        return static_cast<int>(m_capacity);
+    }
+
+    // make room for @p size entries without rehashing
+    void reserve(int size)
+    {
+        size_t capacity = GROUP_SIZE;
+        while (capacity * MAX_LOAD_NUMERATOR / MAX_LOAD_DENOMINATOR < static_cast<size_t>(size)) {
+            capacity *= 2;
+        }
+        if (capacity > m_capacity) {
+            rehash(capacity);
+        }
+    }
+
+    void clear()
+    {
+        destroy();
+        m_control = nullptr;
+        m_slots = nullptr;
+        m_capacity = m_size = m_deleted = 0;
+    }
+
+    void insert(const Key& key, const T& value)
+    {
+        (*this)[key] = value;
+    }
+
+    T& operator[](const Key& key)
+    {
+        const size_t hash = Hasher()(key);
+        size_t index = findIndex(key, hash);
+        if (index == NOT_FOUND) {
+            // not inline in the subscript, the insertion may reallocate m_slots
+            index = insertNew(key, hash);
+        }
+        return m_slots[index].value;
+    }
+
+    bool contains(const Key& key) const
+    {
+        return findIndex(key, Hasher()(key)) != NOT_FOUND;
+    }
+
+    T value(const Key& key, const T& defaultValue = T()) const
+    {
+        const size_t index = findIndex(key, Hasher()(key));
+        return index == NOT_FOUND ? defaultValue : m_slots[index].value;
+    }
+
+    // @return a pointer to the value of @p key, or nullptr
+    const T* find(const Key& key) const
+    {
+        const size_t index = findIndex(key, Hasher()(key));
+        return index == NOT_FOUND ? nullptr : &m_slots[index].value;
+    }
+
+    // heterogeneous lookups, e.g. with a QStringView in a map with QString keys
+    template<typename K, typename = typename FlatHashLookupKey<K, Hasher, KeyEqual>::type>
+    bool contains(const K& key) const
+    {
+        return findIndex(key, Hasher()(key)) != NOT_FOUND;
+    }
+
+    template<typename K, typename = typename FlatHashLookupKey<K, Hasher, KeyEqual>::type>
+    T value(const K& key, const T& defaultValue = T()) const
+    {
+        const size_t index = findIndex(key, Hasher()(key));
+        return index == NOT_FOUND ? defaultValue : m_slots[index].value;
+    }
+
+    template<typename K, typename = typename FlatHashLookupKey<K, Hasher, KeyEqual>::type>
+    const T* find(const K& key) const
+    {
+        const size_t index = findIndex(key, Hasher()(key));
+        return index == NOT_FOUND ? nullptr : &m_slots[index].value;
+    }
+
+    // @return the number of removed entries, i.e. 0 or 1
+    int remove(const Key& key)
+    {
+        const size_t index = findIndex(key, Hasher()(key));
+        if (index == NOT_FOUND) {
+            return 0;
+        }
+        m_slots[index].~Slot();
+        --m_size;
+        // a group without EMPTY slots may be part of other probe sequences
+        if (groupHasEmpty(index & ~(GROUP_SIZE - 1))) {
+            m_control[index] = EMPTY;
+        } else {
+            m_control[index] = DELETED;
+            ++m_deleted;
+        }
+        return 1;
+    }
+
+    const_iterator begin() const
+    {
+        return const_iterator(this, nextFull(0));
+    }
+
+    const_iterator end() const
+    {
+        return const_iterator(this, m_capacity);
+    }
+
+private:
+    static constexpr size_t GROUP_SIZE = 16;
+    static constexpr size_t MAX_LOAD_NUMERATOR = 7;
+    static constexpr size_t MAX_LOAD_DENOMINATOR = 8;
+    static constexpr size_t NOT_FOUND = ~size_t(0);
+    static constexpr qint8 EMPTY = -128;
+    static constexpr qint8 DELETED = -2;
+
+    static qint8 metadata(size_t hash)
+    {
+        return static_cast<qint8>(hash >> (sizeof(size_t) * 8 - 7));
+    }
+
+    // a bit mask of the slots in the group starting at @p group whose control byte is @p control
+    uint matchGroup(size_t group, qint8 control) const
+    {
+#ifdef HAVE_FLATHASH_SIMD
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m_control + group));
+        return static_cast<uint>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(control))));
+#else
+        uint mask = 0;
+        for (size_t i = 0; i < GROUP_SIZE; ++i) {
+            mask |= uint(m_control[group + i] == control) << i;
+        }
+        return mask;
+#endif
+    }
+
+    // a bit mask of the slots in the group starting at @p group which are EMPTY or DELETED
+    uint matchFree(size_t group) const
+    {
+#ifdef HAVE_FLATHASH_SIMD
+        // only the control bytes of full slots are non-negative
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m_control + group));
+        return static_cast<uint>(_mm_movemask_epi8(bytes));
+#else
+        uint mask = 0;
+        for (size_t i = 0; i < GROUP_SIZE; ++i) {
+            mask |= uint(m_control[group + i] < 0) << i;
+        }
+        return mask;
+#endif
+    }
+
+    bool groupHasEmpty(size_t group) const
+    {
+        return matchGroup(group, EMPTY) != 0;
+    }
+
+    template<typename K>
+    size_t findIndex(const K& key, size_t hash) const
+    {
+        if (!m_capacity) {
+            return NOT_FOUND;
+        }
+        const qint8 control = metadata(hash);
+        const size_t groupMask = m_capacity / GROUP_SIZE - 1;
+        size_t group = hash & groupMask;
+        for (size_t step = 1;; ++step) {
+            const size_t offset = group * GROUP_SIZE;
+            for (uint mask = matchGroup(offset, control); mask; mask &= mask - 1) {
+                const size_t index = offset + __builtin_ctz(mask);
+                if (KeyEqual()(m_slots[index].key, key)) {
+                    return index;
+                }
+            }
+            if (groupHasEmpty(offset) || step > groupMask) {
+                return NOT_FOUND;
+            }
+            group = (group + step) & groupMask;
+        }
+    }
+
+    // @return the slot for the new @p key, which must not be in the table yet
+    size_t insertNew(const Key& key, size_t hash)
+    {
+        if ((m_size + m_deleted + 1) * MAX_LOAD_DENOMINATOR > m_capacity * MAX_LOAD_NUMERATOR) {
+            // only grow when the tombstones do not make up for the load
+            rehash(!m_capacity ? GROUP_SIZE : m_size * 4 >= m_capacity ? m_capacity * 2 : m_capacity);
+        }
+        const size_t index = freeIndex(hash);
+        if (m_control[index] == DELETED) {
+            --m_deleted;
+        }
+        m_control[index] = metadata(hash);
+        new (&m_slots[index]) Slot{key, T()};
+        ++m_size;
+        return index;
+    }
+
+    size_t freeIndex(size_t hash) const
+    {
+        const size_t groupMask = m_capacity / GROUP_SIZE - 1;
+        size_t group = hash & groupMask;
+        for (size_t step = 1;; ++step) {
+            const uint mask = matchFree(group * GROUP_SIZE);
+            if (mask) {
+                return group * GROUP_SIZE + __builtin_ctz(mask);
+            }
+            group = (group + step) & groupMask;
+        }
+    }
+
+    size_t nextFull(size_t index) const
+    {
+        while (index < m_capacity && m_control[index] < 0) {
+            ++index;
+        }
+        return index;
+    }
+
+    void rehash(size_t capacity)
+    {
+        qint8* oldControl = m_control;
+        Slot* oldSlots = m_slots;
+        const size_t oldCapacity = m_capacity;
+
+        m_control = static_cast<qint8*>(::operator new(capacity));
+        memset(m_control, EMPTY, capacity);
+        m_slots = static_cast<Slot*>(::operator new(capacity * sizeof(Slot)));
+        m_capacity = capacity;
+        m_deleted = 0;
+
+        for (size_t i = 0; i < oldCapacity; ++i) {
+            if (oldControl[i] >= 0) {
+                const size_t hash = Hasher()(oldSlots[i].key);
+                const size_t index = freeIndex(hash);
+                m_control[index] = metadata(hash);
+                new (&m_slots[index]) Slot(std::move(oldSlots[i]));
+                oldSlots[i].~Slot();
+            }
+        }
+        ::operator delete(oldControl);
+        ::operator delete(oldSlots);
+    }
+
+    void destroy()
+    {
+        for (size_t i = 0; i < m_capacity; ++i) {
+            if (m_control[i] >= 0) {
+                m_slots[i].~Slot();
+            }
+        }
+        ::operator delete(m_control);
+        ::operator delete(m_slots);
+    }
+
+    qint8* m_control = nullptr;
+    Slot* m_slots = nullptr;
+    size_t m_capacity = 0;
+    size_t m_size = 0;
+    size_t m_deleted = 0;
+};
+
+#endif
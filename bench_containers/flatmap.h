@@ -0,0 +1,236 @@
+/**
+ *
+ * Copyright (C) 2015 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com, author Milian Wolff <milian.wolff@kdab.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef BENCH_QT_FLATMAP_H
+#define BENCH_QT_FLATMAP_H
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+enum class FlatMapSearch
+{
+    // a binary search over the sorted keys, which compiles to conditional moves
+    Branchless,
+    // a search over a copy of the keys in Eytzinger (BFS) order, which keeps the
+    // first levels in a few cache lines and allows prefetching the next ones
+    Eytzinger
+};
+
+/**
+ * A map with its keys and values in sorted arrays, for data which is built
+ * once and then looked up a lot.
+ *
+ * Insertions are batched: insert() only queues the entry, commit() sorts the
+ * queue and merges it into the map in a single pass. Lookups and iteration
+ * only see committed entries.
+ *
+ * The entries are addressed by their index in key order, which makes ordered
+ * and range iteration a linear walk over contiguous memory.
+ */
+template<typename Key, typename T, FlatMapSearch Search = FlatMapSearch::Eytzinger>
+class FlatMap
+{
+public:
+    // queue an entry for the next commit(), a later insert of the same key wins
+    void insert(const Key& key, const T& value)
+    {
+        m_pending.emplace_back(key, value);
+    }
+
+    void reserve(int size)
+    {
+        m_keys.reserve(size);
+        m_values.reserve(size);
+    }
+
+    void commit()
+    {
+        if (m_pending.empty()) {
+            return;
+        }
+        std::stable_sort(m_pending.begin(), m_pending.end(),
+                         [](const std::pair<Key, T>& a, const std::pair<Key, T>& b) { return a.first < b.first; });
+
+        std::vector<Key> keys;
+        std::vector<T> values;
+        keys.reserve(m_keys.size() + m_pending.size());
+        values.reserve(m_keys.size() + m_pending.size());
+        size_t i = 0;
+        size_t j = 0;
+        while (i < m_keys.size() || j < m_pending.size()) {
+            if (j < m_pending.size()) {
+                // skip to the last of the pending entries with the same key
+                while (j + 1 < m_pending.size() && !(m_pending[j].first < m_pending[j + 1].first)) {
+                    ++j;
+                }
+            }
+            if (j == m_pending.size() || (i < m_keys.size() && m_keys[i] < m_pending[j].first)) {
+                keys.push_back(std::move(m_keys[i]));
+                values.push_back(std::move(m_values[i]));
+                ++i;
+            } else {
+                if (i < m_keys.size() && !(m_pending[j].first < m_keys[i])) {
+                    // replaced by the pending entry
+                    ++i;
+                }
+                keys.push_back(std::move(m_pending[j].first));
+                values.push_back(std::move(m_pending[j].second));
+                ++j;
+            }
+        }
+        m_keys.swap(keys);
+        m_values.swap(values);
+        m_pending.clear();
+
+        if (Search == FlatMapSearch::Eytzinger) {
+            m_eytzinger.resize(m_keys.size() + 1);
+            m_rank.resize(m_keys.size() + 1);
+            // a lower bound of 0 means past the end
+            m_rank[0] = size();
+            buildEytzinger(0, 1);
+        }
+    }
+
+    int size() const
+    {
+        return static_cast<int>(m_keys.size());
+    }
+
+    bool isEmpty() const
+    {
+        return m_keys.empty();
+    }
+
+    // @return the index of the first key which is not less than @p key, or size()
+    int lowerBound(const Key& key) const
+    {
+        return Search == FlatMapSearch::Eytzinger ? lowerBoundEytzinger(key) : lowerBoundBranchless(key);
+    }
+
+    // @return the index of @p key, or -1
+    int indexOf(const Key& key) const
+    {
+        const int index = lowerBound(key);
+        return index != size() && !(key < m_keys[index]) ? index : -1;
+    }
+
+    bool contains(const Key& key) const
+    {
+        return indexOf(key) != -1;
+    }
+
+    T value(const Key& key, const T& defaultValue = T()) const
+    {
+        const int index = indexOf(key);
+        return index == -1 ? defaultValue : m_values[index];
+    }
+
+    const Key& keyAt(int index) const
+    {
+        return m_keys[index];
+    }
+
+    const T& valueAt(int index) const
+    {
+        return m_values[index];
+    }
+
+    // all keys and values in key order
+    const std::vector<Key>& keys() const
+    {
+        return m_keys;
+    }
+
+    const std::vector<T>& values() const
+    {
+        return m_values;
+    }
+
+private:
+    int lowerBoundBranchless(const Key& key) const
+    {
+        if (m_keys.empty()) {
+            return 0;
+        }
+        const Key* base = m_keys.data();
+        size_t count = m_keys.size();
+        while (count > 1) {
+            const size_t half = count / 2;
+            base = base[half] < key ? base + half : base;
+            count -= half;
+        }
+        return static_cast<int>(base - m_keys.data()) + (*base < key);
+    }
+
+    int lowerBoundEytzinger(const Key& key) const
+    {
+        // the number of keys per cache line, the descendants that many levels down are adjacent
+        if (m_keys.empty()) {
+            return 0;
+        }
+        const size_t prefetchStride = sizeof(Key) < 64 ? 64 / sizeof(Key) : 1;
+        const Key* tree = m_eytzinger.data();
+        const size_t count = m_keys.size();
+        size_t k = 1;
+        while (k <= count) {
+            __builtin_prefetch(tree + k * prefetchStride);
+            k = 2 * k + (tree[k] < key);
+        }
+        // undo the right turns after the last left turn, which went to the lower bound
+        k >>= __builtin_ffsll(static_cast<long long>(~k));
+        return m_rank[k];
+    }
+
+    // fill the subtree at @p node with the sorted keys starting at @p index, @return the next index
+    size_t buildEytzinger(size_t index, size_t node)
+    {
+        if (node <= m_keys.size()) {
+            index = buildEytzinger(index, 2 * node);
+            m_eytzinger[node] = m_keys[index];
+            m_rank[node] = static_cast<int>(index);
+            ++index;
+            index = buildEytzinger(index, 2 * node + 1);
+        }
+        return index;
+    }
+
+    std::vector<Key> m_keys;
+    std::vector<T> m_values;
+    std::vector<std::pair<Key, T>> m_pending;
+    // 1-based, m_rank maps the positions back to the index in m_keys
+    std::vector<Key> m_eytzinger;
+    std::vector<int> m_rank;
+};
+
+#endif
@@ -0,0 +1,311 @@
+/**
+ *
+ * Copyright (C) 2015 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com, author Milian Wolff <milian.wolff@kdab.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef BENCH_QT_STRINGHASH_H
+#define BENCH_QT_STRINGHASH_H
+
+#include <QByteArray>
+#include <QLatin1String>
+#include <QString>
+#include <QStringView>
+#include <QtGlobal>
+
+#include <cstring>
+
+/**
+ * Hashers and key comparisons for FlatHash with string keys.
+ *
+ * The hashers use wyhash, which reads 8 bytes at a time and mixes them with
+ * 64x64->128 bit multiplications. Keys longer than 48 bytes are hashed in
+ * three independent lanes, which keeps the multipliers of a core busy.
+ *
+ * All of them are transparent, such that a FlatHash with QString keys can be
+ * looked up with a QStringView or QLatin1String, and one with QByteArray keys
+ * with a QLatin1String, without creating a temporary key per lookup.
+ */
+namespace StringHash {
+
+namespace detail {
+
+const quint64 SECRET[] = {
+    Q_UINT64_C(0xa0761d6478bd642f),
+    Q_UINT64_C(0xe7037ed1a0b428db),
+    Q_UINT64_C(0x8ebc6af09c88c6e3),
+    Q_UINT64_C(0x589965cc75374cc3)
+};
+
+// the 128 bit product of @p a and @p b, low half in @p a and high half in @p b
+inline void multiply(quint64* a, quint64* b)
+{
+#ifdef __SIZEOF_INT128__
+    const unsigned __int128 product = static_cast<unsigned __int128>(*a) * *b;
+    *a = static_cast<quint64>(product);
+    *b = static_cast<quint64>(product >> 64);
+#else
+    const quint64 aHigh = *a >> 32, aLow = static_cast<quint32>(*a);
+    const quint64 bHigh = *b >> 32, bLow = static_cast<quint32>(*b);
+    const quint64 high = aHigh * bHigh, middle0 = aHigh * bLow, middle1 = aLow * bHigh, low = aLow * bLow;
+    const quint64 t = low + (middle0 << 32);
+    const quint64 carry = t < low;
+    const quint64 lowResult = t + (middle1 << 32);
+    *a = lowResult;
+    *b = high + (middle0 >> 32) + (middle1 >> 32) + carry + (lowResult < t);
+#endif
+}
+
+inline quint64 mix(quint64 a, quint64 b)
+{
+    multiply(&a, &b);
+    return a ^ b;
+}
+
+inline quint64 read64(const uchar* p)
+{
+    quint64 value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline quint64 read32(const uchar* p)
+{
+    quint32 value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+// the first, middle and last byte of the 1 to 3 bytes at @p p
+inline quint64 read3(const uchar* p, size_t length)
+{
+    return (quint64(p[0]) << 16) | (quint64(p[length >> 1]) << 8) | p[length - 1];
+}
+
+}
+
+inline quint64 wyhash(const void* data, size_t length, quint64 seed = 0)
+{
+    using namespace detail;
+    const uchar* p = static_cast<const uchar*>(data);
+    seed ^= mix(seed ^ SECRET[0], SECRET[1]);
+    quint64 a = 0;
+    quint64 b = 0;
+    if (length <= 16) {
+        if (length >= 4) {
+            // two overlapping pairs of 4 byte reads cover 4 to 16 bytes
+            const size_t offset = (length >> 3) << 2;
+            a = (read32(p) << 32) | read32(p + offset);
+            b = (read32(p + length - 4) << 32) | read32(p + length - 4 - offset);
+        } else if (length > 0) {
+            a = read3(p, length);
+        }
+    } else {
+        size_t remaining = length;
+        if (remaining > 48) {
+            quint64 seed1 = seed;
+            quint64 seed2 = seed;
+            do {
+                seed = mix(read64(p) ^ SECRET[1], read64(p + 8) ^ seed);
+                seed1 = mix(read64(p + 16) ^ SECRET[2], read64(p + 24) ^ seed1);
+                seed2 = mix(read64(p + 32) ^ SECRET[3], read64(p + 40) ^ seed2);
+                p += 48;
+                remaining -= 48;
+            } while (remaining > 48);
+            seed ^= seed1 ^ seed2;
+        }
+        while (remaining > 16) {
+            seed = mix(read64(p) ^ SECRET[1], read64(p + 8) ^ seed);
+            p += 16;
+            remaining -= 16;
+        }
+        // the last 16 bytes, which may overlap with the ones hashed above
+        a = read64(p + remaining - 16);
+        b = read64(p + remaining - 8);
+    }
+    a ^= SECRET[1];
+    b ^= seed;
+    multiply(&a, &b);
+    return mix(a ^ SECRET[0] ^ length, b ^ SECRET[1]);
+}
+
+inline size_t hashUtf16(const QChar* data, int size)
+{
+    return static_cast<size_t>(wyhash(data, size * sizeof(QChar)));
+}
+
+// the same hash as hashUtf16 of the Latin-1 string converted to UTF-16
+inline size_t hashLatin1AsUtf16(const char* data, int size)
+{
+    const int BUFFER_SIZE = 256;
+    if (size > BUFFER_SIZE) {
+        // rare for keys, thus not worth hashing chunk wise
+        const QString string = QString::fromLatin1(data, size);
+        return hashUtf16(string.constData(), string.size());
+    }
+    ushort buffer[BUFFER_SIZE];
+    for (int i = 0; i < size; ++i) {
+        buffer[i] = static_cast<uchar>(data[i]);
+    }
+    return static_cast<size_t>(wyhash(buffer, size * sizeof(ushort)));
+}
+
+inline size_t hashLatin1(const char* data, int size)
+{
+    return static_cast<size_t>(wyhash(data, size));
+}
+
+}
+
+template<typename Key>
+struct StringHasher;
+
+// hashes the UTF-16 code units, Latin-1 lookups get converted on the stack
+template<>
+struct StringHasher<QString>
+{
+    using is_transparent = void;
+
+    size_t operator()(const QString& string) const
+    {
+        return StringHash::hashUtf16(string.constData(), string.size());
+    }
+
+    size_t operator()(QStringView string) const
+    {
+        return StringHash::hashUtf16(string.data(), static_cast<int>(string.size()));
+    }
+
+    size_t operator()(QLatin1String string) const
+    {
+        return StringHash::hashLatin1AsUtf16(string.data(), string.size());
+    }
+};
+
+template<>
+struct StringHasher<QByteArray>
+{
+    using is_transparent = void;
+
+    size_t operator()(const QByteArray& string) const
+    {
+        return StringHash::hashLatin1(string.constData(), string.size());
+    }
+
+    size_t operator()(QLatin1String string) const
+    {
+        return StringHash::hashLatin1(string.data(), string.size());
+    }
+};
+
+template<>
+struct StringHasher<QLatin1String> : StringHasher<QByteArray>
+{
+};
+
+struct StringEqual
+{
+    using is_transparent = void;
+
+    bool operator()(QStringView a, QStringView b) const
+    {
+        return a.size() == b.size() && !memcmp(a.data(), b.data(), a.size() * sizeof(QChar));
+    }
+
+    bool operator()(QStringView a, QLatin1String b) const
+    {
+        if (a.size() != b.size()) {
+            return false;
+        }
+        for (int i = 0; i < b.size(); ++i) {
+            if (a[i].unicode() != static_cast<uchar>(b.data()[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool operator()(QLatin1String a, QLatin1String b) const
+    {
+        return a.size() == b.size() && !memcmp(a.data(), b.data(), a.size());
+    }
+
+    bool operator()(const QByteArray& a, QLatin1String b) const
+    {
+        return (*this)(QLatin1String(a), b);
+    }
+
+    bool operator()(const QByteArray& a, const QByteArray& b) const
+    {
+        return a == b;
+    }
+};
+
+/**
+ * A string with its hash computed up front, for keys which are looked up
+ * repeatedly, e.g. property names which are known at compile time.
+ */
+template<typename String>
+struct HashedString
+{
+    String string;
+    size_t hash;
+};
+
+template<typename Hasher, typename String>
+HashedString<String> hashedString(const String& string)
+{
+    return {string, Hasher()(string)};
+}
+
+struct HashedStringHasher
+{
+    using is_transparent = void;
+
+    template<typename String>
+    size_t operator()(const HashedString<String>& key) const
+    {
+        return key.hash;
+    }
+};
+
+// only compares the strings if the hashes are equal
+struct HashedStringEqual
+{
+    using is_transparent = void;
+
+    template<typename A, typename B>
+    bool operator()(const HashedString<A>& a, const HashedString<B>& b) const
+    {
+        return a.hash == b.hash && StringEqual()(a.string, b.string);
+    }
+};
+
+#endif
@@ -36,12 +36,23 @@
 #include <chrono>
 
 #include "../util.h"
+#include "../report.h"
 
 class BenchQDateTime : public QObject
 {
     Q_OBJECT
 
 private slots:
+    void init()
+    {
+        BenchReport::startPerfCounters();
+    }
+
+    void cleanup()
+    {
+        BenchReport::stopPerfCounters();
+    }
+
     Q_NEVER_INLINE void benchCurrentDateTime()
     {
         QBENCHMARK {
@@ -142,6 +153,6 @@ private slots:
     }
 };
 
-QTEST_GUILESS_MAIN(BenchQDateTime)
+BENCH_QT_GUILESS_MAIN(BenchQDateTime)
 
 #include "bench_qdatetime.moc"
@@ -34,14 +34,133 @@
 #include <QObject>
 
 #include "../util.h"
+#include "../report.h"
+#include "../stats.h"
+#include "dircrawler.h"
+#include "direntries.h"
+#include "dircache.h"
+#include "fixture.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace {
+// all files in a single directory, for the listing benchmarks
+FixtureSpec flatFixture(int files, int nameLength = 12)
+{
+    FixtureSpec spec;
+    spec.files = files;
+    spec.nameLength = nameLength;
+    spec.hiddenPercent = 5;
+    spec.symlinkPercent = 5;
+    return spec;
+}
+
+// 1111 directories three levels deep, for the crawling benchmarks
+FixtureSpec treeFixture(int files)
+{
+    FixtureSpec spec = flatFixture(files);
+    spec.depth = 3;
+    spec.fanOut = 10;
+    return spec;
+}
+
+/**
+ * The fixtures with at most $BENCH_QT_FIXTURE_MAX_FILES files, 1M by default.
+ */
+QVector<QPair<QByteArray, FixtureSpec>> availableFixtures(const QVector<QPair<QByteArray, FixtureSpec>>& fixtures)
+{
+    const int maxFiles = BenchStats::envValue("BENCH_QT_FIXTURE_MAX_FILES", 1000000);
+    QVector<QPair<QByteArray, FixtureSpec>> available;
+    for (const auto& fixture : fixtures) {
+        if (fixture.second.files <= maxFiles) {
+            available << fixture;
+        }
+    }
+    return available;
+}
+
+QVector<QPair<QByteArray, FixtureSpec>> flatFixtures()
+{
+    return availableFixtures({
+        {"flat/10", flatFixture(10)},
+        {"flat/1000", flatFixture(1000)},
+        {"flat/100000", flatFixture(100000)},
+        {"flat/100000/long", flatFixture(100000, 100)},
+        {"flat/1000000", flatFixture(1000000)}
+    });
+}
+
+QVector<QPair<QByteArray, FixtureSpec>> treeFixtures()
+{
+    return availableFixtures({
+        {"tree/10000", treeFixture(10000)},
+        {"tree/100000", treeFixture(100000)},
+        {"tree/1000000", treeFixture(1000000)}
+    });
+}
+
+void addFixtureRows(const QVector<QPair<QByteArray, FixtureSpec>>& fixtures)
+{
+    QTest::addColumn<FixtureSpec>("fixture");
+    for (const auto& fixture : fixtures) {
+        QTest::newRow(fixture.first.constData()) << fixture.second;
+    }
+}
+
+/**
+ * The fixtures are created on first use and kept until the process exits,
+ * as the larger ones take a while to create.
+ */
+const DirFixture& cachedFixture(const FixtureSpec& spec)
+{
+    static std::vector<std::pair<FixtureSpec, std::unique_ptr<DirFixture>>> fixtures;
+    for (const auto& fixture : fixtures) {
+        if (fixture.first == spec) {
+            return *fixture.second;
+        }
+    }
+    QElapsedTimer timer;
+    timer.start();
+    fixtures.emplace_back(spec, std::unique_ptr<DirFixture>(new DirFixture(spec)));
+    const DirFixture& created = *fixtures.back().second;
+    qDebug("created %lld entries in %d directories in %lld ms", created.entries(), created.directories(),
+           timer.elapsed());
+    return created;
+}
+
+#ifdef HAVE_DIRCACHE
+/**
+ * Update @p cache until it does or does not contain @p name, as given by
+ * @p present.
+ *
+ * @return false if that did not happen within ten seconds
+ */
+bool waitForEntry(DirCache& cache, const QString& name, bool present)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while ((cache.indexOf(name) != -1) != present) {
+        if (timer.hasExpired(10000)) {
+            return false;
+        }
+        cache.waitForChanges(100);
+        cache.update();
+    }
+    return true;
+}
+#endif
+}
 
 /**
  * A benchmark for common QDir operations.
  *
  * Note that the tests should be compared between each other.
- * Individually, their absolute numbers don't have much meaning as they
- * depend on the number of files in your home dir, on whether you are using
- * an SSD, on your file system, etc. pp.
+ * The benchmarks run against generated fixtures of several sizes, see
+ * DirFixture, such that the scaling is comparable between machines. Still,
+ * the absolute numbers depend on whether you are using an SSD, on your file
+ * system, etc. pp.
  *
  * But all the tests here do essentially the same, thus pick the faster pattern.
  *
@@ -55,9 +174,27 @@ class BenchQDir : public QObject
     Q_OBJECT
 
 private slots:
+    void init()
+    {
+        BenchReport::startPerfCounters();
+    }
+
+    void cleanup()
+    {
+        BenchReport::stopPerfCounters();
+    }
+
+    Q_NEVER_INLINE void benchQDirEntryList_data()
+    {
+        addFixtureRows(flatFixtures());
+    }
+
     Q_NEVER_INLINE void benchQDirEntryList()
     {
-        QDir dir = QDir::home();
+        QFETCH(FixtureSpec, fixture);
+        const DirFixture& tree = cachedFixture(fixture);
+        QVERIFY(tree.isValid());
+        QDir dir(tree.path());
         QBENCHMARK {
             foreach (const QString& entry, dir.entryList()) {
                 const QFileInfo info(dir.filePath(entry));
@@ -70,9 +207,17 @@ private slots:
         }
     }
 
+    Q_NEVER_INLINE void benchQDirEntryInfoList_data()
+    {
+        addFixtureRows(flatFixtures());
+    }
+
     Q_NEVER_INLINE void benchQDirEntryInfoList()
     {
-        QDir dir = QDir::home();
+        QFETCH(FixtureSpec, fixture);
+        const DirFixture& tree = cachedFixture(fixture);
+        QVERIFY(tree.isValid());
+        QDir dir(tree.path());
         QBENCHMARK {
             foreach (const QFileInfo& info, dir.entryInfoList()) {
                 const QString& entry = info.fileName();
@@ -85,9 +230,17 @@ private slots:
         }
     }
 
+    Q_NEVER_INLINE void benchQDirIterator_data()
+    {
+        addFixtureRows(flatFixtures());
+    }
+
     Q_NEVER_INLINE void benchQDirIterator()
     {
-        QDir dir = QDir::home();
+        QFETCH(FixtureSpec, fixture);
+        const DirFixture& tree = cachedFixture(fixture);
+        QVERIFY(tree.isValid());
+        QDir dir(tree.path());
         QBENCHMARK {
             QDirIterator it(dir);
             while (it.hasNext()) {
@@ -102,8 +255,222 @@ private slots:
             }
         }
     }
+
+    Q_NEVER_INLINE void benchGetdents_data()
+    {
+        addFixtureRows(flatFixtures());
+    }
+
+    // like the above, but with the entry types from getdents64 instead of a stat per entry
+    Q_NEVER_INLINE void benchGetdents()
+    {
+        if (!DirEntries::isAvailable()) {
+            QSKIP("getdents64 is only available on Linux");
+        }
+        QFETCH(FixtureSpec, fixture);
+        const DirFixture& tree = cachedFixture(fixture);
+        QVERIFY(tree.isValid());
+        const QString path = tree.path();
+        qint64 entries = 0;
+        QVERIFY(DirEntries::list(path, [&entries](const char*, int, DirEntries::Type) {
+            ++entries;
+        }));
+        QCOMPARE(entries, tree.entries());
+        QBENCHMARK {
+            DirEntries::list(path, [](const char* name, int length, DirEntries::Type type) {
+                const QString entry = QFile::decodeName(QByteArray::fromRawData(name, length));
+                bool isFolder = type == DirEntries::Type::Directory;
+                bool isFile = type == DirEntries::Type::File;
+                escape(&isFolder);
+                escape(&isFile);
+                escape(&entry);
+            });
+        }
+    }
+
+    Q_NEVER_INLINE void benchDirCacheCold_data()
+    {
+        addFixtureRows(flatFixtures());
+    }
+
+    // the initial scan of the cache, compare to benchQDirEntryInfoList
+    Q_NEVER_INLINE void benchDirCacheCold()
+    {
+#ifdef HAVE_DIRCACHE
+        QFETCH(FixtureSpec, fixture);
+        const DirFixture& tree = cachedFixture(fixture);
+        QVERIFY(tree.isValid());
+        const QString path = tree.path();
+        {
+            DirCache cache(path);
+            QVERIFY(cache.isValid());
+            QCOMPARE(static_cast<qint64>(cache.count()), tree.entries());
+        }
+        QBENCHMARK {
+            DirCache cache(path);
+            int count = cache.count();
+            escape(&count);
+        }
+#else
+        QSKIP("the directory cache requires getdents64 and inotify");
+#endif
+    }
+
+    Q_NEVER_INLINE void benchDirCacheWarm_data()
+    {
+        addFixtureRows(flatFixtures());
+    }
+
+    // listing the same directory again through the cache, compare to benchQDirEntryInfoList
+    Q_NEVER_INLINE void benchDirCacheWarm()
+    {
+#ifdef HAVE_DIRCACHE
+        QFETCH(FixtureSpec, fixture);
+        const DirFixture& tree = cachedFixture(fixture);
+        QVERIFY(tree.isValid());
+        DirCache cache(tree.path());
+        QVERIFY(cache.isValid());
+        QBENCHMARK {
+            cache.update();
+            for (int i = 0, count = cache.count(); i < count; ++i) {
+                const DirCache::Entry& info = cache.at(i);
+                QStringView entry = cache.name(info);
+                bool isFolder = info.type == DirEntries::Type::Directory;
+                bool isFile = info.type == DirEntries::Type::File;
+                escape(&isFolder);
+                escape(&isFile);
+                escape(&entry);
+            }
+        }
+#else
+        QSKIP("the directory cache requires getdents64 and inotify");
+#endif
+    }
+
+    Q_NEVER_INLINE void benchDirCacheChange_data()
+    {
+        addFixtureRows(flatFixtures());
+    }
+
+    // the time until a created and then removed file is reflected in the cache
+    Q_NEVER_INLINE void benchDirCacheChange()
+    {
+#ifdef HAVE_DIRCACHE
+        QFETCH(FixtureSpec, fixture);
+        const DirFixture& tree = cachedFixture(fixture);
+        QVERIFY(tree.isValid());
+        DirCache cache(tree.path());
+        QVERIFY(cache.isValid());
+        const QString name = QStringLiteral("bench_qt_change.txt");
+        const QString path = QDir(tree.path()).filePath(name);
+        QBENCHMARK {
+            QFile file(path);
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            file.close();
+            if (!waitForEntry(cache, name, true)) {
+                QFAIL("the cache did not see the created file");
+            }
+            QVERIFY(QFile::remove(path));
+            if (!waitForEntry(cache, name, false)) {
+                QFAIL("the cache did not see the removed file");
+            }
+        }
+        QCOMPARE(static_cast<qint64>(cache.count()), tree.entries());
+#else
+        QSKIP("the directory cache requires getdents64 and inotify");
+#endif
+    }
+
+    Q_NEVER_INLINE void benchEntryInfoListChange_data()
+    {
+        addFixtureRows(flatFixtures());
+    }
+
+    // like benchDirCacheChange, but seeing the changes by listing the directory again
+    Q_NEVER_INLINE void benchEntryInfoListChange()
+    {
+        QFETCH(FixtureSpec, fixture);
+        const DirFixture& tree = cachedFixture(fixture);
+        QVERIFY(tree.isValid());
+        const QDir dir(tree.path());
+        const QString name = QStringLiteral("bench_qt_change.txt");
+        const QString path = dir.filePath(name);
+        auto contains = [&dir, &name]() {
+            foreach (const QFileInfo& info, dir.entryInfoList(CRAWL_FILTERS)) {
+                if (info.fileName() == name) {
+                    return true;
+                }
+            }
+            return false;
+        };
+        QBENCHMARK {
+            QFile file(path);
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            file.close();
+            QVERIFY(contains());
+            QVERIFY(QFile::remove(path));
+            QVERIFY(!contains());
+        }
+    }
+
+    Q_NEVER_INLINE void benchCrawlRecursive_data()
+    {
+        addFixtureRows(treeFixtures());
+    }
+
+    Q_NEVER_INLINE void benchCrawlRecursive()
+    {
+        QFETCH(FixtureSpec, fixture);
+        const DirFixture& tree = cachedFixture(fixture);
+        QVERIFY(tree.isValid());
+        const QString root = tree.path();
+        qint64 entries = 0;
+        BenchStats::report(BenchStats::measure(tree.entries(), [&] {
+            entries = 0;
+            QDirIterator it(root, CRAWL_FILTERS, QDirIterator::Subdirectories);
+            while (it.hasNext()) {
+                it.next();
+                const QFileInfo& info = it.fileInfo();
+                bool isFolder = info.isDir();
+                escape(&isFolder);
+                ++entries;
+            }
+        }));
+        QCOMPARE(entries, tree.entries());
+    }
+
+    Q_NEVER_INLINE void benchCrawlParallel_data()
+    {
+        QTest::addColumn<FixtureSpec>("fixture");
+        QTest::addColumn<int>("threads");
+        for (const auto& fixture : treeFixtures()) {
+            foreach (int threads, threadCounts()) {
+                QTest::newRow(qPrintable(QStringLiteral("%1/%2").arg(QLatin1String(fixture.first)).arg(threads)))
+                    << fixture.second << threads;
+            }
+        }
+    }
+
+    Q_NEVER_INLINE void benchCrawlParallel()
+    {
+        QFETCH(FixtureSpec, fixture);
+        QFETCH(int, threads);
+        const DirFixture& tree = cachedFixture(fixture);
+        QVERIFY(tree.isValid());
+        const QString root = tree.path();
+        ParallelDirCrawler crawler(threads);
+        const BenchStats::Summary summary = BenchStats::measure(tree.entries(), [&] {
+            crawler.start(root);
+            runThreads(threads, [&](int thread) {
+                crawler.work(thread);
+            });
+        });
+        QCOMPARE(crawler.entries(), tree.entries());
+        qDebug("%.0f entries/s", 1E9 / summary.median);
+        BenchStats::report(summary);
+    }
 };
 
-QTEST_GUILESS_MAIN(BenchQDir)
+BENCH_QT_GUILESS_MAIN(BenchQDir)
 
 #include "bench_qdir.moc"
@@ -1,10 +1,15 @@
 TEMPLATE = app
 
 QT += testlib
-CONFIG += c++11 testcase release
+CONFIG += c++1z testcase release
 
 linux|mac {
     QMAKE_CXXFLAGS += -g
 }
 
+HEADERS = dircrawler.h \
+          fixture.h \
+          direntries.h \
+          dircache.h
+
 SOURCES = bench_qdir.cpp
@@ -0,0 +1,247 @@
+/**
+ *
+ * Copyright (C) 2015 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com, author Milian Wolff <milian.wolff@kdab.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef BENCH_QT_DIRCACHE_H
+#define BENCH_QT_DIRCACHE_H
+
+#include "direntries.h"
+
+#include <QHash>
+#include <QString>
+#include <QStringView>
+
+#include <vector>
+
+#ifdef HAVE_GETDENTS64
+#include <poll.h>
+#include <sys/inotify.h>
+#define HAVE_DIRCACHE
+
+/**
+ * A snapshot of the entries of a directory and their metadata, which is kept
+ * up to date incrementally via inotify.
+ *
+ * The entries are stored in a flat table with all names in a single string,
+ * such that walking the cached listing touches as little memory as possible.
+ * The order of the entries is unspecified.
+ *
+ * Changes are only applied by update(), which is cheap when nothing changed.
+ * When the kernel drops events, the directory is scanned again.
+ */
+class DirCache
+{
+public:
+    struct Entry
+    {
+        int nameOffset;
+        int nameLength;
+        DirEntries::Type type;
+        qint64 size;
+        // nanoseconds since the epoch
+        qint64 modified;
+    };
+
+    explicit DirCache(const QString& path)
+        : m_dirFd(open(QFile::encodeName(path).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC))
+        , m_inotifyFd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC))
+    {
+        if (m_dirFd < 0 || m_inotifyFd < 0) {
+            return;
+        }
+        // watch before scanning, such that no change can slip through in between
+        m_watch = inotify_add_watch(m_inotifyFd, QFile::encodeName(path).constData(),
+                                    IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_MODIFY | IN_ATTRIB
+                                        | IN_CLOSE_WRITE);
+        if (m_watch < 0) {
+            return;
+        }
+        rescan();
+    }
+
+    ~DirCache()
+    {
+        if (m_dirFd >= 0) {
+            close(m_dirFd);
+        }
+        if (m_inotifyFd >= 0) {
+            close(m_inotifyFd);
+        }
+    }
+
+    Q_DISABLE_COPY(DirCache)
+
+    // false if the directory could not be opened or watched, e.g. when out of inotify watches
+    bool isValid() const
+    {
+        return m_dirFd >= 0 && m_inotifyFd >= 0 && m_watch >= 0;
+    }
+
+    int count() const
+    {
+        return static_cast<int>(m_entries.size());
+    }
+
+    const Entry& at(int index) const
+    {
+        return m_entries[index];
+    }
+
+    QStringView name(const Entry& entry) const
+    {
+        return QStringView(m_names.constData() + entry.nameOffset, entry.nameLength);
+    }
+
+    // @return the index of the entry called @p name, or -1
+    int indexOf(const QString& name) const
+    {
+        return m_index.value(name, -1);
+    }
+
+    // wait up to @p timeout milliseconds for changes, @return true when there are some to apply
+    bool waitForChanges(int timeout) const
+    {
+        pollfd fd = {m_inotifyFd, POLLIN, 0};
+        return poll(&fd, 1, timeout) > 0;
+    }
+
+    /**
+     * Apply the pending changes.
+     *
+     * @return the number of inotify events that were processed
+     */
+    int update()
+    {
+        alignas(inotify_event) char buffer[64 * 1024];
+        int events = 0;
+        while (true) {
+            const ssize_t size = read(m_inotifyFd, buffer, sizeof(buffer));
+            if (size <= 0) {
+                return events;
+            }
+            for (ssize_t offset = 0; offset < size;) {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+                offset += sizeof(inotify_event) + event->len;
+                ++events;
+                if (event->mask & IN_Q_OVERFLOW) {
+                    rescan();
+                } else if (!event->len) {
+                    // an event for the directory itself
+                    continue;
+                } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                    remove(QFile::decodeName(QByteArray(event->name)));
+                } else {
+                    refresh(event->name, QFile::decodeName(QByteArray(event->name)));
+                }
+            }
+        }
+    }
+
+private:
+    void rescan()
+    {
+        m_entries.clear();
+        m_names.clear();
+        m_index.clear();
+        m_garbage = 0;
+        DirEntries::list(m_dirFd, [this](const char* name, int length, DirEntries::Type) {
+            refresh(name, QFile::decodeName(QByteArray::fromRawData(name, length)));
+        });
+    }
+
+    // stat the entry @p name and insert or update it, @p decoded is its name as QString
+    void refresh(const char* name, const QString& decoded)
+    {
+        struct stat info;
+        if (fstatat(m_dirFd, name, &info, AT_SYMLINK_NOFOLLOW) != 0) {
+            // already gone again
+            remove(decoded);
+            return;
+        }
+        int index = indexOf(decoded);
+        if (index == -1) {
+            index = count();
+            m_entries.push_back({m_names.size(), decoded.size(), DirEntries::Type::Other, 0, 0});
+            m_names += decoded;
+            m_index.insert(decoded, index);
+        }
+        Entry& entry = m_entries[index];
+        entry.type = DirEntries::typeOfMode(info.st_mode);
+        entry.size = info.st_size;
+        entry.modified = info.st_mtim.tv_sec * Q_INT64_C(1000000000) + info.st_mtim.tv_nsec;
+    }
+
+    void remove(const QString& entryName)
+    {
+        const int index = indexOf(entryName);
+        if (index == -1) {
+            return;
+        }
+        m_index.remove(entryName);
+        m_garbage += m_entries[index].nameLength;
+        // move the last entry into the gap, to keep the table dense
+        if (index != count() - 1) {
+            m_entries[index] = m_entries.back();
+            m_index[name(m_entries[index]).toString()] = index;
+        }
+        m_entries.pop_back();
+        if (m_garbage > m_names.size() / 2) {
+            compactNames();
+        }
+    }
+
+    void compactNames()
+    {
+        QString names;
+        names.reserve(m_names.size() - m_garbage);
+        for (Entry& entry : m_entries) {
+            const int offset = names.size();
+            names.append(m_names.constData() + entry.nameOffset, entry.nameLength);
+            entry.nameOffset = offset;
+        }
+        m_names = names;
+        m_garbage = 0;
+    }
+
+    int m_dirFd;
+    int m_inotifyFd;
+    // the inotify watch descriptor of the directory
+    int m_watch = -1;
+    std::vector<Entry> m_entries;
+    QString m_names;
+    // the number of characters in m_names which belong to removed entries
+    int m_garbage = 0;
+    QHash<QString, int> m_index;
+};
+#endif
+
+#endif
@@ -0,0 +1,167 @@
+/**
+ *
+ * Copyright (C) 2015 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com, author Milian Wolff <milian.wolff@kdab.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef BENCH_QT_DIRCRAWLER_H
+#define BENCH_QT_DIRCRAWLER_H
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QString>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// all entries but . and .., like a file indexer would want to see them
+const QDir::Filters CRAWL_FILTERS = QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System;
+
+/**
+ * Walks a directory tree with a fixed number of workers.
+ *
+ * Every worker lists one directory at a time with a non-recursive QDirIterator
+ * and queues the subdirectories it finds in its own deque. A worker takes the
+ * most recently found directory from its own deque, which keeps the walk depth
+ * first and local. When that is empty, it steals the oldest directory from
+ * another worker, which tends to be the root of a large subtree.
+ *
+ * Like QDirIterator::Subdirectories, symlinks to directories are not followed.
+ *
+ * Usage: call start(), then work() from one thread per worker, e.g. via
+ * runThreads(). work() returns once the whole tree was walked.
+ */
+class ParallelDirCrawler
+{
+public:
+    explicit ParallelDirCrawler(int numWorkers)
+    {
+        for (int i = 0; i < numWorkers; ++i) {
+            m_workers.emplace_back(new Worker);
+        }
+    }
+
+    void start(const QString& root)
+    {
+        for (auto& worker : m_workers) {
+            worker->directories.clear();
+            worker->entries = 0;
+        }
+        m_pending = 1;
+        m_workers[0]->directories.push_back(root);
+    }
+
+    void work(int worker)
+    {
+        Worker& self = *m_workers[worker];
+        QString directory;
+        while (true) {
+            if (pop(self, &directory) || steal(worker, &directory)) {
+                list(directory, self);
+                m_pending.fetch_sub(1, std::memory_order_release);
+            } else if (m_pending.load(std::memory_order_acquire) == 0) {
+                return;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    // the number of entries found by the last walk
+    qint64 entries() const
+    {
+        qint64 entries = 0;
+        for (const auto& worker : m_workers) {
+            entries += worker->entries;
+        }
+        return entries;
+    }
+
+private:
+    // aligned to avoid false sharing of the entry counters
+    struct alignas(64) Worker
+    {
+        std::mutex mutex;
+        std::deque<QString> directories;
+        qint64 entries = 0;
+    };
+
+    void list(const QString& directory, Worker& self)
+    {
+        QDirIterator it(directory, CRAWL_FILTERS);
+        while (it.hasNext()) {
+            it.next();
+            ++self.entries;
+            const QFileInfo& info = it.fileInfo();
+            if (info.isDir() && !info.isSymLink()) {
+                // before queuing, such that the pending count never drops to zero too early
+                m_pending.fetch_add(1, std::memory_order_relaxed);
+                std::lock_guard<std::mutex> lock(self.mutex);
+                self.directories.push_back(info.filePath());
+            }
+        }
+    }
+
+    static bool pop(Worker& self, QString* directory)
+    {
+        std::lock_guard<std::mutex> lock(self.mutex);
+        if (self.directories.empty()) {
+            return false;
+        }
+        *directory = std::move(self.directories.back());
+        self.directories.pop_back();
+        return true;
+    }
+
+    bool steal(int thief, QString* directory)
+    {
+        const int numWorkers = static_cast<int>(m_workers.size());
+        for (int i = 1; i < numWorkers; ++i) {
+            Worker& victim = *m_workers[(thief + i) % numWorkers];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.directories.empty()) {
+                *directory = std::move(victim.directories.front());
+                victim.directories.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::atomic<int> m_pending{0};
+};
+
+#endif
@@ -0,0 +1,181 @@
+/**
+ *
+ * Copyright (C) 2015 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com, author Milian Wolff <milian.wolff@kdab.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef BENCH_QT_DIRENTRIES_H
+#define BENCH_QT_DIRENTRIES_H
+
+#include <QFile>
+#include <QString>
+
+#include <cstring>
+#include <memory>
+
+#ifdef Q_OS_LINUX
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define HAVE_GETDENTS64
+#endif
+
+/**
+ * Directory listing straight from getdents64, without a stat per entry.
+ *
+ * The entry type is taken from d_type, which most file systems fill in. Only
+ * for DT_UNKNOWN an fstatat() relative to the directory is needed. Unlike
+ * QFileInfo::isDir(), symlinks are reported as such and not followed, as that
+ * would require a stat again.
+ */
+namespace DirEntries {
+
+enum class Type
+{
+    File,
+    Directory,
+    Symlink,
+    Other
+};
+
+inline bool isAvailable()
+{
+#ifdef HAVE_GETDENTS64
+    return true;
+#else
+    return false;
+#endif
+}
+
+#ifdef HAVE_GETDENTS64
+// large enough for a few thousand entries per syscall
+const size_t BUFFER_SIZE = 256 * 1024;
+
+// the kernel ABI of getdents64, glibc only exposes it as struct dirent64 since 2.30
+struct LinuxDirent64
+{
+    quint64 d_ino;
+    qint64 d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+
+inline Type typeOfMode(mode_t mode)
+{
+    return S_ISREG(mode) ? Type::File
+         : S_ISDIR(mode) ? Type::Directory
+         : S_ISLNK(mode) ? Type::Symlink
+         : Type::Other;
+}
+
+inline Type typeOf(int dirFd, const LinuxDirent64* entry)
+{
+    switch (entry->d_type) {
+    case DT_REG:
+        return Type::File;
+    case DT_DIR:
+        return Type::Directory;
+    case DT_LNK:
+        return Type::Symlink;
+    case DT_UNKNOWN: {
+        struct stat info;
+        if (fstatat(dirFd, entry->d_name, &info, AT_SYMLINK_NOFOLLOW) != 0) {
+            return Type::Other;
+        }
+        return typeOfMode(info.st_mode);
+    }
+    default:
+        return Type::Other;
+    }
+}
+#endif
+
+#ifdef HAVE_GETDENTS64
+/**
+ * Like list() below, but for the already opened directory @p dirFd, which is
+ * read from the start again and stays open.
+ */
+template<typename Func>
+bool list(int dirFd, Func func)
+{
+    static thread_local std::unique_ptr<char[]> buffer(new char[BUFFER_SIZE]);
+    if (lseek(dirFd, 0, SEEK_SET) != 0) {
+        return false;
+    }
+    while (true) {
+        const long size = syscall(SYS_getdents64, dirFd, buffer.get(), BUFFER_SIZE);
+        if (size <= 0) {
+            return size == 0;
+        }
+        for (long offset = 0; offset < size;) {
+            const LinuxDirent64* entry = reinterpret_cast<const LinuxDirent64*>(buffer.get() + offset);
+            offset += entry->d_reclen;
+            const char* name = entry->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+                continue;
+            }
+            func(name, static_cast<int>(strlen(name)), typeOf(dirFd, entry));
+        }
+    }
+}
+#endif
+
+/**
+ * Call @p func with the name, its length and the Type of every entry in
+ * @p path but . and .., in directory order.
+ *
+ * The name is only valid during the call.
+ *
+ * @return false when the directory could not be read
+ */
+template<typename Func>
+bool list(const QString& path, Func func)
+{
+#ifdef HAVE_GETDENTS64
+    const int fd = open(QFile::encodeName(path).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    const bool ok = list(fd, func);
+    close(fd);
+    return ok;
+#else
+    Q_UNUSED(path);
+    Q_UNUSED(func);
+    return false;
+#endif
+}
+
+}
+
+#endif
@@ -0,0 +1,210 @@
+/**
+ *
+ * Copyright (C) 2015 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com, author Milian Wolff <milian.wolff@kdab.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef BENCH_QT_FIXTURE_H
+#define BENCH_QT_FIXTURE_H
+
+#include <QDir>
+#include <QFile>
+#include <QMetaType>
+#include <QString>
+#include <QTemporaryDir>
+#include <QVector>
+
+/**
+ * The shape of a generated directory tree, see DirFixture.
+ */
+struct FixtureSpec
+{
+    // the number of directory levels below the root, 0 puts all files into the root
+    int depth = 0;
+    // the number of subdirectories per directory
+    int fanOut = 0;
+    // the number of files, spread evenly over all directories
+    int files = 0;
+    // the number of random characters in each name, a unique suffix gets appended
+    int nameLength = 12;
+    // the percentage of files which are hidden, i.e. start with a dot
+    int hiddenPercent = 0;
+    // the percentage of files which are symlinks to another file in the same directory
+    int symlinkPercent = 0;
+
+    bool operator==(const FixtureSpec& other) const
+    {
+        return depth == other.depth && fanOut == other.fanOut && files == other.files
+            && nameLength == other.nameLength && hiddenPercent == other.hiddenPercent
+            && symlinkPercent == other.symlinkPercent;
+    }
+};
+Q_DECLARE_METATYPE(FixtureSpec)
+
+/**
+ * A reproducible directory tree in a temporary directory, which is removed
+ * again in the destructor.
+ *
+ * The same spec always yields the same names and structure. The tree is
+ * created below $BENCH_QT_FIXTURE_DIR if set, to benchmark a particular file
+ * system, and below the default temporary directory otherwise.
+ */
+class DirFixture
+{
+public:
+    explicit DirFixture(const FixtureSpec& spec)
+        : m_dir(fixtureTemplate())
+    {
+        if (!m_dir.isValid()) {
+            return;
+        }
+
+        // breadth first, such that the files are spread over all levels
+        QVector<QString> directories;
+        directories << m_dir.path();
+        for (int i = 0; i < directories.size(); ++i) {
+            if (depthOf(i, spec.fanOut) >= spec.depth) {
+                break;
+            }
+            const QDir parent(directories[i]);
+            for (int j = 0; j < spec.fanOut; ++j) {
+                const QString name = randomName(spec.nameLength, directories.size());
+                if (!parent.mkdir(name)) {
+                    qWarning("failed to create the fixture directory %s", qPrintable(parent.filePath(name)));
+                    return;
+                }
+                directories << parent.filePath(name);
+            }
+        }
+        m_entries = directories.size() - 1;
+        m_directories = directories.size();
+
+        // the last regular file per directory, as symlink target
+        QVector<QString> targets(directories.size());
+        for (int i = 0; i < spec.files; ++i) {
+            const int directory = i % directories.size();
+            const QDir dir(directories[directory]);
+            const bool hidden = static_cast<int>(next() % 100) < spec.hiddenPercent;
+            const bool symlink = static_cast<int>(next() % 100) < spec.symlinkPercent;
+            const QString name = (hidden ? QStringLiteral(".") : QString()) + randomName(spec.nameLength, i)
+                               + QStringLiteral(".txt");
+            if (symlink && !targets[directory].isEmpty()) {
+                if (!QFile::link(targets[directory], dir.filePath(name))) {
+                    qWarning("failed to create the fixture symlink %s", qPrintable(dir.filePath(name)));
+                    return;
+                }
+            } else {
+                QFile file(dir.filePath(name));
+                if (!file.open(QIODevice::WriteOnly)) {
+                    qWarning("failed to create the fixture file %s: %s", qPrintable(file.fileName()),
+                             qPrintable(file.errorString()));
+                    return;
+                }
+                targets[directory] = name;
+            }
+            ++m_entries;
+        }
+        m_complete = true;
+    }
+
+    // false if the tree could not be created completely, entries() are not reliable then
+    bool isValid() const
+    {
+        return m_complete;
+    }
+
+    QString path() const
+    {
+        return m_dir.path();
+    }
+
+    // the number of files, symlinks and directories below path(), not counting path() itself
+    qint64 entries() const
+    {
+        return m_entries;
+    }
+
+    // the number of directories including path()
+    int directories() const
+    {
+        return m_directories;
+    }
+
+private:
+    static QString fixtureTemplate()
+    {
+        QString base = QString::fromLocal8Bit(qgetenv("BENCH_QT_FIXTURE_DIR"));
+        if (base.isEmpty()) {
+            base = QDir::tempPath();
+        }
+        return QDir(base).filePath(QStringLiteral("bench_qt_fixture-XXXXXX"));
+    }
+
+    // the depth of the directory at @p index in breadth first order, the root has depth 0
+    static int depthOf(int index, int fanOut)
+    {
+        int depth = 0;
+        int levelEnd = 1;
+        int levelSize = 1;
+        while (index >= levelEnd) {
+            levelSize *= fanOut;
+            levelEnd += levelSize;
+            ++depth;
+        }
+        return depth;
+    }
+
+    quint32 next()
+    {
+        // xorshift32
+        m_random ^= m_random << 13;
+        m_random ^= m_random >> 17;
+        m_random ^= m_random << 5;
+        return m_random;
+    }
+
+    QString randomName(int length, int unique)
+    {
+        static const char CHARACTERS[] = "abcdefghijklmnopqrstuvwxyz0123456789_-";
+        QString name(length, Qt::Uninitialized);
+        for (int i = 0; i < length; ++i) {
+            name[i] = QLatin1Char(CHARACTERS[next() % (sizeof(CHARACTERS) - 1)]);
+        }
+        return name + QLatin1Char('_') + QString::number(unique, 36);
+    }
+
+    QTemporaryDir m_dir;
+    quint32 m_random = 42;
+    qint64 m_entries = 0;
+    int m_directories = 0;
+    bool m_complete = false;
+};
+
+#endif
@@ -33,38 +33,326 @@
 #include <QtTest>
 #include <QObject>
 #include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <memory>
+#include <string>
 
 #include "../util.h"
+#include "../report.h"
+
+namespace {
+
+const int ACQUISITIONS_PER_THREAD = 20000;
+const int OPS_PER_THREAD = 100000;
+// the read:write ratios used by the bench*Mix() tests, in percent of reads
+const int READ_PERCENTAGES[] = {100, 99, 90, 50};
+
+qint64 percentile(std::vector<qint64>& values, double p)
+{
+    auto nth = values.begin() + static_cast<size_t>(p * (values.size() - 1));
+    std::nth_element(values.begin(), nth, values.end());
+    return *nth;
+}
+
+/**
+ * Let @p numThreads threads hammer on the same lock and report the throughput
+ * as well as the p50/p99 latency of acquiring the lock.
+ *
+ * The wait latency includes the overhead of querying the steady clock, which
+ * is constant and thus does not affect the shape of the scaling curve.
+ */
+template<typename Lock, typename Unlock>
+void benchContended(int numThreads, Lock lock, Unlock unlock)
+{
+    std::vector<std::vector<qint64>> waits(numThreads, std::vector<qint64>(ACQUISITIONS_PER_THREAD));
+    const qint64 elapsed = runThreads(numThreads, [&](int thread) {
+        auto& waitNs = waits[thread];
+        for (int i = 0; i < ACQUISITIONS_PER_THREAD; ++i) {
+            const auto start = std::chrono::steady_clock::now();
+            lock();
+            const auto acquired = std::chrono::steady_clock::now();
+            clobber();
+            unlock();
+            waitNs[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(acquired - start).count();
+        }
+    });
+
+    std::vector<qint64> allWaits;
+    allWaits.reserve(static_cast<size_t>(numThreads) * ACQUISITIONS_PER_THREAD);
+    for (const auto& waitNs : waits) {
+        allWaits.insert(allWaits.end(), waitNs.begin(), waitNs.end());
+    }
+    const qint64 acquisitions = static_cast<qint64>(allWaits.size());
+    const double throughput = acquisitions * 1E9 / elapsed;
+    const qint64 p50 = percentile(allWaits, 0.50);
+    const qint64 p99 = percentile(allWaits, 0.99);
+
+    qDebug("%d threads: %.0f acquisitions/sec, wait p50: %lld ns, p99: %lld ns",
+           numThreads, throughput, p50, p99);
+    QTest::setBenchmarkResult(static_cast<qreal>(elapsed) / acquisitions, QTest::WalltimeNanoseconds);
+}
+
+const int CONFIG_VALUES = 8;
+
+// the data protected by the primitives in the read/write mix benchmarks
+struct Config
+{
+    int sum() const
+    {
+        return std::accumulate(std::begin(values), std::end(values), 0);
+    }
+
+    void increment()
+    {
+        for (auto& value : values) {
+            ++value;
+        }
+    }
+
+    int values[CONFIG_VALUES] = {};
+};
+
+class QReadWriteLockConfig
+{
+public:
+    explicit QReadWriteLockConfig(QReadWriteLock::RecursionMode mode)
+        : m_lock(mode)
+    {
+    }
+
+    int read(int /*thread*/)
+    {
+        QReadLocker lock(&m_lock);
+        return m_config.sum();
+    }
+
+    void write(int /*thread*/)
+    {
+        QWriteLocker lock(&m_lock);
+        m_config.increment();
+    }
+
+private:
+    QReadWriteLock m_lock;
+    Config m_config;
+};
+
+class SharedMutexConfig
+{
+public:
+    int read(int /*thread*/)
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        return m_config.sum();
+    }
+
+    void write(int /*thread*/)
+    {
+        std::lock_guard<std::shared_mutex> lock(m_mutex);
+        m_config.increment();
+    }
+
+private:
+    std::shared_mutex m_mutex;
+    Config m_config;
+};
+
+/**
+ * Readers never write to shared memory, instead they retry when a writer
+ * was active in the meantime. Writers are serialized by a mutex.
+ */
+class SeqLockConfig
+{
+public:
+    SeqLockConfig()
+    {
+        for (auto& value : m_values) {
+            value.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    int read(int /*thread*/)
+    {
+        unsigned before = 0;
+        unsigned after = 0;
+        int sum = 0;
+        do {
+            before = m_sequence.load(std::memory_order_acquire);
+            sum = 0;
+            for (const auto& value : m_values) {
+                sum += value.load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = m_sequence.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+        return sum;
+    }
+
+    void write(int /*thread*/)
+    {
+        std::lock_guard<std::mutex> lock(m_writeMutex);
+        const unsigned sequence = m_sequence.load(std::memory_order_relaxed);
+        m_sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (auto& value : m_values) {
+            value.store(value.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+        m_sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+private:
+    std::atomic<unsigned> m_sequence{0};
+    std::atomic<int> m_values[CONFIG_VALUES];
+    std::mutex m_writeMutex;
+};
+
+/**
+ * Readers only dereference the current pointer, writers publish an updated
+ * copy and wait for a grace period before deleting the old one.
+ *
+ * Every reader thread owns a counter which is odd while it is inside a read
+ * section. The grace period is over once every reader that was inside a read
+ * section when the pointer got swapped has left it again.
+ */
+class RcuConfig
+{
+public:
+    explicit RcuConfig(int numThreads)
+        : m_readers(new ReaderState[numThreads])
+        , m_numThreads(numThreads)
+        , m_current(new Config)
+    {
+    }
+
+    ~RcuConfig()
+    {
+        delete m_current.load();
+    }
+
+    int read(int thread)
+    {
+        auto& counter = m_readers[thread].counter;
+        counter.fetch_add(1, std::memory_order_seq_cst);
+        const int sum = m_current.load(std::memory_order_seq_cst)->sum();
+        counter.fetch_add(1, std::memory_order_release);
+        return sum;
+    }
+
+    void write(int /*thread*/)
+    {
+        std::lock_guard<std::mutex> lock(m_writeMutex);
+        Config* old = m_current.load(std::memory_order_relaxed);
+        Config* updated = new Config(*old);
+        updated->increment();
+        m_current.store(updated, std::memory_order_seq_cst);
+        synchronize();
+        delete old;
+    }
+
+private:
+    void synchronize()
+    {
+        for (int i = 0; i < m_numThreads; ++i) {
+            const auto& counter = m_readers[i].counter;
+            const unsigned snapshot = counter.load(std::memory_order_seq_cst);
+            if (snapshot & 1) {
+                while (counter.load(std::memory_order_acquire) == snapshot) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+    }
+
+    // one cache line per reader to prevent false sharing
+    struct alignas(64) ReaderState
+    {
+        std::atomic<unsigned> counter{0};
+    };
+    std::unique_ptr<ReaderState[]> m_readers;
+    const int m_numThreads;
+    std::atomic<Config*> m_current;
+    std::mutex m_writeMutex;
+};
+
+/**
+ * Let @p numThreads threads read or write the data protected by @p primitive,
+ * where @p readPercent of the operations are reads.
+ *
+ * The sequence of reads and writes is precomputed per thread, such that the
+ * random number generation doesn't end up in the measurement.
+ */
+template<typename Primitive>
+void benchReadWriteMix(int numThreads, int readPercent, Primitive& primitive)
+{
+    std::vector<std::vector<char>> writes(numThreads, std::vector<char>(OPS_PER_THREAD));
+    for (int thread = 0; thread < numThreads; ++thread) {
+        std::mt19937 generator(thread);
+        std::uniform_int_distribution<int> distribution(0, 99);
+        std::generate(writes[thread].begin(), writes[thread].end(), [&] {
+            return distribution(generator) >= readPercent;
+        });
+    }
+
+    const qint64 elapsed = runThreads(numThreads, [&](int thread) {
+        const auto& isWrite = writes[thread];
+        for (int i = 0; i < OPS_PER_THREAD; ++i) {
+            if (isWrite[i]) {
+                primitive.write(thread);
+            } else {
+                int sum = primitive.read(thread);
+                escape(&sum);
+            }
+        }
+    });
+
+    const qint64 ops = static_cast<qint64>(numThreads) * OPS_PER_THREAD;
+    qDebug("%d threads, %d%% reads: %.0f ops/sec", numThreads, readPercent, ops * 1E9 / elapsed);
+    QTest::setBenchmarkResult(static_cast<qreal>(elapsed) / ops, QTest::WalltimeNanoseconds);
+}
+
+}
 
 /**
- * This benchmark measures the performance of the *non-contended* overhead of
- * locking various mutex classes.
+ * This benchmark measures the performance of locking various mutex classes.
+ *
+ * The bench*() tests measure the *non-contended* overhead, i.e. a single
+ * thread locking and unlocking the mutex over and over.
+ *
+ * The bench*Contended() tests let 1, 2, 4, ... up to hardware_concurrency
+ * threads fight for the same lock. The reported result is the wall time per
+ * acquisition across all threads, i.e. the inverse of the throughput. The
+ * throughput in acquisitions/sec as well as the p50/p99 latency of waiting for
+ * the lock are printed as debug output. Look for the thread count where the
+ * numbers start to get worse to see where a lock stops scaling.
+ *
+ * The bench*Mix() tests compare QReadWriteLock against alternatives for
+ * read-mostly data: std::shared_mutex, a seqlock and an RCU-style pointer swap.
+ * Each thread performs a mix of reads and writes according to the configured
+ * read:write ratio. Again, the wall time per operation is reported.
  *
  * For more information on QMutex, see:
  * http://woboq.com/blog/internals-of-qmutex-in-qt5.html
- *
- * TODO: add tests for the contented case as well.
  */
 class BenchQMutex : public QObject
 {
     Q_OBJECT
 
-private:
-    // ensure at least two threads are running
-    QThread secondaryThread;
-
 private slots:
-    void initTestCase()
+    void init()
     {
-        QSignalSpy spy(&secondaryThread, &QThread::started);
-        secondaryThread.start();
-        QVERIFY(spy.wait());
+        BenchReport::startPerfCounters();
     }
 
-    void cleanupTestCase()
+    void cleanup()
     {
-        secondaryThread.quit();
-        QVERIFY(secondaryThread.wait());
+        BenchReport::stopPerfCounters();
     }
 
     Q_NEVER_INLINE void benchQMutex_data()
@@ -131,8 +419,159 @@ private slots:
             clobber();
         }
     }
+
+    Q_NEVER_INLINE void benchContended_data()
+    {
+        QTest::addColumn<int>("threads");
+        foreach (int threads, threadCounts()) {
+            QTest::newRow(std::to_string(threads).data()) << threads;
+        }
+    }
+
+    Q_NEVER_INLINE void benchQMutexContended_data()
+    {
+        QTest::addColumn<bool>("recursive");
+        QTest::addColumn<int>("threads");
+        foreach (int threads, threadCounts()) {
+            QTest::newRow(("recursive/" + std::to_string(threads)).data()) << true << threads;
+            QTest::newRow(("non-recursive/" + std::to_string(threads)).data()) << false << threads;
+        }
+    }
+
+    Q_NEVER_INLINE void benchQMutexContended()
+    {
+        QFETCH(bool, recursive);
+        QFETCH(int, threads);
+        QMutex mutex(recursive ? QMutex::Recursive : QMutex::NonRecursive);
+        benchContended(threads, [&] { mutex.lock(); }, [&] { mutex.unlock(); });
+    }
+
+    Q_NEVER_INLINE void benchStdMutexContended_data()
+    {
+        benchContended_data();
+    }
+
+    Q_NEVER_INLINE void benchStdMutexContended()
+    {
+        QFETCH(int, threads);
+        std::mutex mutex;
+        benchContended(threads, [&] { mutex.lock(); }, [&] { mutex.unlock(); });
+    }
+
+    Q_NEVER_INLINE void benchStdRecursiveMutexContended_data()
+    {
+        benchContended_data();
+    }
+
+    Q_NEVER_INLINE void benchStdRecursiveMutexContended()
+    {
+        QFETCH(int, threads);
+        std::recursive_mutex mutex;
+        benchContended(threads, [&] { mutex.lock(); }, [&] { mutex.unlock(); });
+    }
+
+    Q_NEVER_INLINE void benchQReadWriteLockReadContended_data()
+    {
+        benchQMutexContended_data();
+    }
+
+    Q_NEVER_INLINE void benchQReadWriteLockReadContended()
+    {
+        QFETCH(bool, recursive);
+        QFETCH(int, threads);
+        QReadWriteLock mutex(recursive ? QReadWriteLock::Recursive : QReadWriteLock::NonRecursive);
+        benchContended(threads, [&] { mutex.lockForRead(); }, [&] { mutex.unlock(); });
+    }
+
+    Q_NEVER_INLINE void benchQReadWriteLockWriteContended_data()
+    {
+        benchQMutexContended_data();
+    }
+
+    Q_NEVER_INLINE void benchQReadWriteLockWriteContended()
+    {
+        QFETCH(bool, recursive);
+        QFETCH(int, threads);
+        QReadWriteLock mutex(recursive ? QReadWriteLock::Recursive : QReadWriteLock::NonRecursive);
+        benchContended(threads, [&] { mutex.lockForWrite(); }, [&] { mutex.unlock(); });
+    }
+
+    Q_NEVER_INLINE void benchMix_data()
+    {
+        QTest::addColumn<int>("readPercent");
+        QTest::addColumn<int>("threads");
+        for (int readPercent : READ_PERCENTAGES) {
+            const std::string ratio = std::to_string(readPercent) + ':' + std::to_string(100 - readPercent);
+            foreach (int threads, threadCounts()) {
+                QTest::newRow((ratio + '/' + std::to_string(threads)).data()) << readPercent << threads;
+            }
+        }
+    }
+
+    Q_NEVER_INLINE void benchQReadWriteLockMix_data()
+    {
+        QTest::addColumn<bool>("recursive");
+        QTest::addColumn<int>("readPercent");
+        QTest::addColumn<int>("threads");
+        for (int readPercent : READ_PERCENTAGES) {
+            const std::string ratio = std::to_string(readPercent) + ':' + std::to_string(100 - readPercent);
+            foreach (int threads, threadCounts()) {
+                const std::string suffix = '/' + ratio + '/' + std::to_string(threads);
+                QTest::newRow(("recursive" + suffix).data()) << true << readPercent << threads;
+                QTest::newRow(("non-recursive" + suffix).data()) << false << readPercent << threads;
+            }
+        }
+    }
+
+    Q_NEVER_INLINE void benchQReadWriteLockMix()
+    {
+        QFETCH(bool, recursive);
+        QFETCH(int, readPercent);
+        QFETCH(int, threads);
+        QReadWriteLockConfig config(recursive ? QReadWriteLock::Recursive : QReadWriteLock::NonRecursive);
+        benchReadWriteMix(threads, readPercent, config);
+    }
+
+    Q_NEVER_INLINE void benchStdSharedMutexMix_data()
+    {
+        benchMix_data();
+    }
+
+    Q_NEVER_INLINE void benchStdSharedMutexMix()
+    {
+        QFETCH(int, readPercent);
+        QFETCH(int, threads);
+        SharedMutexConfig config;
+        benchReadWriteMix(threads, readPercent, config);
+    }
+
+    Q_NEVER_INLINE void benchSeqLockMix_data()
+    {
+        benchMix_data();
+    }
+
+    Q_NEVER_INLINE void benchSeqLockMix()
+    {
+        QFETCH(int, readPercent);
+        QFETCH(int, threads);
+        SeqLockConfig config;
+        benchReadWriteMix(threads, readPercent, config);
+    }
+
+    Q_NEVER_INLINE void benchRcuMix_data()
+    {
+        benchMix_data();
+    }
+
+    Q_NEVER_INLINE void benchRcuMix()
+    {
+        QFETCH(int, readPercent);
+        QFETCH(int, threads);
+        RcuConfig config(threads);
+        benchReadWriteMix(threads, readPercent, config);
+    }
 };
 
-QTEST_GUILESS_MAIN(BenchQMutex)
+BENCH_QT_GUILESS_MAIN(BenchQMutex)
 
 #include "bench_qmutex.moc"
@@ -1,7 +1,7 @@
 TEMPLATE = app
 
 QT += testlib
-CONFIG += c++11 testcase release
+CONFIG += c++1z testcase release
 
 linux|mac {
     QMAKE_CXXFLAGS += -g
@@ -33,9 +33,16 @@
 #include <QtTest>
 #include <QObject>
 #include <QString>
+#include <QReadWriteLock>
 #include "../util.h"
+#include "../report.h"
+#include "../stats.h"
 
 #include <codecvt>
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
 
 template<int MAX_SIZE>
 class ConvertQStringToUtf8_codecvt
@@ -44,7 +51,7 @@ public:
   const char* operator() (const QString& string)
   {
     std::codecvt_utf8_utf16<char16_t> codec;
-    std::mbstate_t state;
+    std::mbstate_t state = std::mbstate_t();
     const char16_t* from_next = nullptr;
     char* to_next = nullptr;
     codec.out(state,
@@ -117,11 +124,530 @@ private:
 
 #define qFastUtf8Printable_QUtf8Functions(max_size, string) ConvertQStringToUtf8_QUtf8Functions<max_size>()(string)
 
+#include "utf8simd.h"
+#include "stringbatch.h"
+#include "stringsearch.h"
+#include "stringpool.h"
+#include "formattemplate.h"
+#include "stringbuilder.h"
+
+template<int MAX_SIZE>
+class ConvertQStringToUtf8_SIMD
+{
+public:
+  const char* operator() (const QString& string)
+  {
+    const int size = Utf8Simd::convert(string.utf16(), string.size(), m_buffer, MAX_SIZE - 1);
+    m_buffer[size] = 0;
+    return m_buffer;
+  }
+
+private:
+  char m_buffer[MAX_SIZE] = {0};
+};
+
+#define qFastUtf8Printable_SIMD(max_size, string) ConvertQStringToUtf8_SIMD<max_size>()(string)
+
+/**
+ * Growable conversion buffers, reused by all conversions on the current thread.
+ *
+ * Every conversion which does not fit its stack buffer borrows one until the end
+ * of the full expression, such that e.g. multiple qFastUtf8Printable arguments to
+ * a single printf call stay valid. After warm up, no allocations happen anymore.
+ */
+class Utf8ScratchBuffers
+{
+public:
+  static std::vector<char> acquire(size_t size)
+  {
+    auto& buffers = freeBuffers();
+    std::vector<char> buffer;
+    if (!buffers.empty()) {
+      buffer = std::move(buffers.back());
+      buffers.pop_back();
+    }
+    if (buffer.size() < size) {
+      buffer.resize(size);
+    }
+    return buffer;
+  }
+
+  static void release(std::vector<char>&& buffer)
+  {
+    freeBuffers().push_back(std::move(buffer));
+  }
+
+private:
+  static std::vector<std::vector<char>>& freeBuffers()
+  {
+    static thread_local std::vector<std::vector<char>> buffers;
+    return buffers;
+  }
+};
+
+/**
+ * A drop-in replacement for qUtf8Printable without truncation.
+ *
+ * Short strings are converted into a buffer of STACK_SIZE bytes on the stack,
+ * longer ones into a thread local scratch buffer. The returned pointer stays
+ * valid until the end of the full expression, just like for qUtf8Printable.
+ */
+template<int STACK_SIZE>
+class ConvertQStringToUtf8
+{
+public:
+  ConvertQStringToUtf8() = default;
+  ConvertQStringToUtf8(const ConvertQStringToUtf8&) = delete;
+  ConvertQStringToUtf8& operator=(const ConvertQStringToUtf8&) = delete;
+
+  ~ConvertQStringToUtf8()
+  {
+    if (!m_heapBuffer.empty()) {
+      Utf8ScratchBuffers::release(std::move(m_heapBuffer));
+    }
+  }
+
+  const char* operator() (const QString& string)
+  {
+    // a UTF-16 code unit never takes more than three bytes in UTF-8
+    const size_t maxSize = static_cast<size_t>(string.size()) * 3 + 1;
+    char* buffer = m_buffer;
+    if (maxSize > STACK_SIZE) {
+      if (m_heapBuffer.empty()) {
+        m_heapBuffer = Utf8ScratchBuffers::acquire(maxSize);
+      } else if (m_heapBuffer.size() < maxSize) {
+        m_heapBuffer.resize(maxSize);
+      }
+      buffer = m_heapBuffer.data();
+    }
+    const int size = Utf8Simd::convert(string.utf16(), string.size(), buffer, static_cast<int>(maxSize - 1));
+    buffer[size] = 0;
+    return buffer;
+  }
+
+private:
+  // intentionally left uninitialized
+  char m_buffer[STACK_SIZE];
+  std::vector<char> m_heapBuffer;
+};
+
+// like qUtf8Printable, but faster for short strings and never truncating
+#define qFastUtf8Printable(string) ConvertQStringToUtf8<256>()(string)
+
+namespace {
+// large enough for the biggest input of benchUtf8Conversion
+const int MAX_CONVERSION_SIZE = 1024 * 1024 + 4;
+
+/**
+ * Repeat @p sample until its UTF-8 representation has @p utf8Size bytes,
+ * without splitting surrogate pairs.
+ */
+QString repeatToUtf8Size(const QString& sample, int utf8Size)
+{
+  QString text;
+  text.reserve(utf8Size);
+  int bytes = 0;
+  int i = 0;
+  while (true) {
+    const ushort uc = sample.at(i).unicode();
+    const int units = QChar::isHighSurrogate(uc) ? 2 : 1;
+    const int length = units == 2 ? 4 : uc < 0x80 ? 1 : uc < 0x800 ? 2 : 3;
+    if (bytes + length > utf8Size) {
+      break;
+    }
+    text.append(sample.constData() + i, units);
+    bytes += length;
+    i = (i + units) % sample.size();
+  }
+  return text;
+}
+
+// the number of strings per batch in the batch conversion benchmarks
+const int BATCH_STRINGS = 10000;
+
+// strings between 4 and 100 bytes of UTF-8, like typical keys, names or log messages
+QStringList makeBatch(const QString& sample)
+{
+  QStringList strings;
+  strings.reserve(BATCH_STRINGS);
+  for (int i = 0; i < BATCH_STRINGS; ++i) {
+    strings << repeatToUtf8Size(sample, 4 + (i * 37) % 97);
+  }
+  return strings;
+}
+
+// the words of the log like haystacks for the search benchmarks
+const char* const LOG_WORDS[] = {
+  "the", "connection", "to", "server", "was", "established", "request", "failed", "with",
+  "status", "user", "login", "timeout", "after", "retry", "received", "bytes", "from",
+  "client", "debug", "info", "warning", "cache", "miss", "hit", "for", "key", "value"
+};
+const int NUM_LOG_WORDS = sizeof(LOG_WORDS) / sizeof(LOG_WORDS[0]);
+
+// a needle which does not occur in the log words, but starts and ends with common characters
+QString makeNeedle(int length)
+{
+  if (length == 1) {
+    return QStringLiteral("#");
+  }
+  QString needle(length, QLatin1Char('e'));
+  for (int i = 1; i < length - 1; ++i) {
+    needle[i] = QLatin1Char('A' + i % 26);
+  }
+  needle[length - 1] = QLatin1Char('t');
+  return needle;
+}
+
+/**
+ * Deterministic log like text of @p bytes bytes, which ends with @p needle.
+ *
+ * The last haystack is cached, as the larger ones take a while to generate.
+ */
+const QString& makeHaystack(int bytes, const QString& needle)
+{
+  static QString haystack;
+  static int cachedBytes = -1;
+  static QString cachedNeedle;
+  if (bytes == cachedBytes && needle == cachedNeedle) {
+    return haystack;
+  }
+  const int size = bytes / 2 - needle.size();
+  haystack.clear();
+  haystack.reserve(size + 64);
+  quint32 random = 42;
+  while (haystack.size() < size) {
+    // xorshift32
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+    haystack += QLatin1String(LOG_WORDS[random % NUM_LOG_WORDS]);
+    haystack += QLatin1Char(' ');
+  }
+  haystack.truncate(size);
+  haystack += needle;
+  cachedBytes = bytes;
+  cachedNeedle = needle;
+  return haystack;
+}
+
+// verify that @p search finds the needle at the end of the haystack and benchmark it
+template<typename Search>
+void benchSearch(const QString& haystack, const QString& needle, Search search)
+{
+  QCOMPARE(search(), haystack.size() - needle.size());
+  QBENCHMARK {
+    int index = search();
+    escape(&index);
+  }
+}
+
+// two word phrases, some of which occur in the log like haystacks
+QStringList makePatterns(int count)
+{
+  QStringList patterns;
+  for (int i = 0; patterns.size() < count; ++i) {
+    patterns << QLatin1String(LOG_WORDS[i % NUM_LOG_WORDS]) + QLatin1Char(' ')
+                + QLatin1String(LOG_WORDS[(i / NUM_LOG_WORDS + i * 7 + 3) % NUM_LOG_WORDS]);
+    patterns.removeDuplicates();
+  }
+  return patterns;
+}
+
+// the number of strings in the interning datasets
+const int DATASET_STRINGS = 100000;
+
+const char* const PROPERTY_NAMES[] = {
+  "objectName", "visible", "enabled", "geometry", "x", "y", "width", "height", "text",
+  "color", "opacity", "parent", "font", "checked", "focus", "anchors", "model", "delegate",
+  "currentIndex", "count", "source", "state", "transitions", "z", "clip", "scale", "rotation"
+};
+
+/**
+ * Strings with many duplicates, each in its own allocation like after parsing.
+ *
+ * "properties" draws from a few dozen property names, "json" from a couple of
+ * common JSON keys and 1000 numbered fields.
+ */
+QVector<QString> makeDataset(const QByteArray& name)
+{
+  QVector<QString> strings;
+  strings.reserve(DATASET_STRINGS);
+  quint32 random = 42;
+  for (int i = 0; i < DATASET_STRINGS; ++i) {
+    // xorshift32
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+    QByteArray string;
+    if (name == "properties") {
+      string = PROPERTY_NAMES[random % (sizeof(PROPERTY_NAMES) / sizeof(PROPERTY_NAMES[0]))];
+    } else if (random % 4) {
+      string = PROPERTY_NAMES[random % 8] + QByteArray("_id");
+    } else {
+      string = "field_" + QByteArray::number(static_cast<int>(random % 1000));
+    }
+    strings << QString::fromLatin1(string);
+  }
+  return strings;
+}
+
+// the format patterns with 3, 10 and 30 placeholders, each preceded by a literal
+constexpr char16_t FORMAT_3[] = u"k1=%1 k2=%2 k3=%3";
+constexpr char16_t FORMAT_10[] = u"k1=%1 k2=%2 k3=%3 k4=%4 k5=%5 k6=%6 k7=%7 k8=%8 k9=%9 k10=%10";
+constexpr char16_t FORMAT_30[] =
+  u"k1=%1 k2=%2 k3=%3 k4=%4 k5=%5 k6=%6 k7=%7 k8=%8 k9=%9 k10=%10 k11=%11 k12=%12 k13=%13 k14=%14 k15=%15 "
+  u"k16=%16 k17=%17 k18=%18 k19=%19 k20=%20 k21=%21 k22=%22 k23=%23 k24=%24 k25=%25 k26=%26 k27=%27 "
+  u"k28=%28 k29=%29 k30=%30";
+
+constexpr auto STATIC_FORMAT_3 = staticFormat(FORMAT_3);
+constexpr auto STATIC_FORMAT_10 = staticFormat(FORMAT_10);
+constexpr auto STATIC_FORMAT_30 = staticFormat(FORMAT_30);
+static_assert(STATIC_FORMAT_30.argumentCount() == 30, "the format pattern should be parsed at compile time");
+
+QString formatPattern(int placeholders)
+{
+  switch (placeholders) {
+  case 3:
+    return QString::fromUtf16(FORMAT_3);
+  case 10:
+    return QString::fromUtf16(FORMAT_10);
+  case 30:
+    return QString::fromUtf16(FORMAT_30);
+  }
+  return {};
+}
+
+// the literal in front of the placeholder for the argument at @p index
+QString formatLiteral(int index)
+{
+  return index ? QStringLiteral(" k%1=").arg(index + 1) : QStringLiteral("k1=");
+}
+
+// arguments of varying length for the format benchmarks
+QVector<QString> formatArguments(int count)
+{
+  QVector<QString> arguments;
+  for (int i = 0; i < count; ++i) {
+    arguments << QStringLiteral("value") + QString::number(i * i * 7);
+  }
+  return arguments;
+}
+
+QString expectedFormat(const QVector<QString>& arguments)
+{
+  QString expected;
+  for (int i = 0; i < arguments.size(); ++i) {
+    expected += formatLiteral(i) + arguments[i];
+  }
+  return expected;
+}
+
+// the multi-arg overload of QString::arg takes at most nine arguments, apply it repeatedly for more
+QString multiArg(const QString& pattern, const QVector<QString>& arguments)
+{
+  QString result = pattern;
+  for (int i = 0; i < arguments.size(); i += 9) {
+    const QString* a = arguments.constData() + i;
+    switch (std::min(arguments.size() - i, 9)) {
+    case 1: result = result.arg(a[0]); break;
+    case 2: result = result.arg(a[0], a[1]); break;
+    case 3: result = result.arg(a[0], a[1], a[2]); break;
+    case 4: result = result.arg(a[0], a[1], a[2], a[3]); break;
+    case 5: result = result.arg(a[0], a[1], a[2], a[3], a[4]); break;
+    case 6: result = result.arg(a[0], a[1], a[2], a[3], a[4], a[5]); break;
+    case 7: result = result.arg(a[0], a[1], a[2], a[3], a[4], a[5], a[6]); break;
+    case 8: result = result.arg(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7]); break;
+    case 9: result = result.arg(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], a[8]); break;
+    }
+  }
+  return result;
+}
+
+// a single QStringBuilder expression over all literals and arguments, like benchQStringConcatFast
+template<std::size_t... I>
+QString concatenate(const QString* literals, const QString* arguments, std::index_sequence<I...>)
+{
+  return (QString() % ... % (literals[I] % arguments[I]));
+}
+
+QString concatenate(const QVector<QString>& literals, const QVector<QString>& arguments)
+{
+  switch (arguments.size()) {
+  case 3:
+    return concatenate(literals.constData(), arguments.constData(), std::make_index_sequence<3>());
+  case 10:
+    return concatenate(literals.constData(), arguments.constData(), std::make_index_sequence<10>());
+  case 30:
+    return concatenate(literals.constData(), arguments.constData(), std::make_index_sequence<30>());
+  }
+  return {};
+}
+
+// verify that @p format fills the pattern of the current benchmark row and benchmark it
+template<typename Format>
+void benchFormat(Format format)
+{
+  QFETCH(int, placeholders);
+  const QVector<QString> arguments = formatArguments(placeholders);
+  QVector<const QString*> pointers;
+  for (const QString& argument : arguments) {
+    pointers << &argument;
+  }
+  QCOMPARE(format(arguments, pointers), expectedFormat(arguments));
+  QBENCHMARK {
+    clobber();
+    QString formatted = format(arguments, pointers);
+    escape(&formatted);
+  }
+}
+
+// the kinds of fragments appended in the string builder benchmarks
+enum FragmentKind
+{
+  Latin1Fragments,
+  Utf16Fragments,
+  NumberFragments,
+  // all of the above in turn, like a report generator
+  MixedFragments
+};
+
+// QString::operator+= behind the interface of StringBuilderBase
+class QStringAppender
+{
+public:
+  QStringAppender& append(QLatin1String string)
+  {
+    m_string += string;
+    return *this;
+  }
+
+  QStringAppender& append(const QString& string)
+  {
+    m_string += string;
+    return *this;
+  }
+
+  QStringAppender& appendNumber(qlonglong value)
+  {
+    m_string += QString::number(value);
+    return *this;
+  }
+
+  QString toString() const
+  {
+    return m_string;
+  }
+
+  // releases the buffer, like for a new QString
+  void clear()
+  {
+    m_string.clear();
+  }
+
+private:
+  QString m_string;
+};
+
+/**
+ * The fragments for the string builder benchmarks, the Latin-1 ones are the
+ * log words and the UTF-16 ones are words in various scripts.
+ */
+struct Fragments
+{
+  Fragments()
+  {
+    for (const char* word : LOG_WORDS) {
+      latin1 << QLatin1String(word);
+    }
+    utf16 << QString::fromUtf8("größe") << QString::fromUtf8("naïve") << QString::fromUtf8("データ")
+          << QString::fromUtf8("значение") << QString::fromUtf8("✓ done") << QString::fromUtf8("😀");
+  }
+
+  template<typename Builder>
+  void appendTo(Builder& builder, int kind, int appends) const
+  {
+    for (int i = 0; i < appends; ++i) {
+      switch (kind == MixedFragments ? i % 3 : kind) {
+      case Latin1Fragments:
+        builder.append(latin1[i % latin1.size()]);
+        break;
+      case Utf16Fragments:
+        builder.append(utf16[i % utf16.size()]);
+        break;
+      case NumberFragments:
+        builder.appendNumber(i * 7919LL - 100000);
+        break;
+      }
+    }
+  }
+
+  QVector<QLatin1String> latin1;
+  QVector<QString> utf16;
+};
+
+/**
+ * Build the string of the current benchmark row with @p Builder and turn it
+ * into a QString.
+ *
+ * The builder is reused for all iterations and cleared in between, such that
+ * the builders which keep their memory around can benefit from that.
+ */
+template<typename Builder>
+void benchStringBuilder()
+{
+  QFETCH(int, fragments);
+  QFETCH(int, appends);
+  const Fragments input;
+  QStringAppender reference;
+  input.appendTo(reference, fragments, appends);
+  std::unique_ptr<Builder> builder(new Builder);
+  input.appendTo(*builder, fragments, appends);
+  QCOMPARE(builder->toString(), reference.toString());
+  QBENCHMARK {
+    builder->clear();
+    input.appendTo(*builder, fragments, appends);
+    QString string = builder->toString();
+    escape(&string);
+  }
+}
+
+/**
+ * Convert the "string" of the current benchmark row with @p Converter.
+ *
+ * The converter is allocated once up front, such that only the conversion is
+ * measured and not the initialization of its buffer.
+ */
+template<typename Converter>
+void benchConverter()
+{
+  QFETCH(QString, string);
+  std::unique_ptr<Converter> converter(new Converter);
+  QBENCHMARK {
+    escape((*converter)(string));
+  }
+}
+}
+
 class BenchQString : public QObject
 {
     Q_OBJECT
 
 private slots:
+    void initTestCase()
+    {
+        qDebug("simd utf8 converter: %s", Utf8Simd::converterName());
+    }
+
+    void init()
+    {
+        BenchReport::startPerfCounters();
+    }
+
+    void cleanup()
+    {
+        BenchReport::stopPerfCounters();
+    }
+
     Q_NEVER_INLINE void benchQStringCompareRaw()
     {
         const QString foo = QStringLiteral("foo");
@@ -152,6 +678,150 @@ private slots:
         }
     }
 
+    Q_NEVER_INLINE void benchAtomCompare()
+    {
+        StringPool pool;
+        const Atom foo = pool.intern(QLatin1String("foo"));
+        const Atom other = pool.intern(QStringLiteral("foo"));
+        QBENCHMARK {
+            clobber();
+            bool equal = (foo == other);
+            escape(&equal);
+        }
+    }
+
+    Q_NEVER_INLINE void benchInternLatin1()
+    {
+        StringPool pool;
+        pool.intern(QLatin1String("foo"));
+        QBENCHMARK {
+            clobber();
+            Atom atom = pool.intern(QLatin1String("foo"));
+            escape(&atom);
+        }
+    }
+
+    Q_NEVER_INLINE void benchInternNew()
+    {
+        QVector<QString> strings;
+        for (int i = 0; i < DATASET_STRINGS; ++i) {
+            strings << QStringLiteral("unique_%1").arg(i);
+        }
+        QBENCHMARK {
+            StringPool pool;
+            for (const QString& string : strings) {
+                Atom atom = pool.intern(string);
+                escape(&atom);
+            }
+        }
+    }
+
+    Q_NEVER_INLINE void benchIntern_data()
+    {
+        QTest::addColumn<QByteArray>("dataset");
+        QTest::newRow("properties") << QByteArray("properties");
+        QTest::newRow("json") << QByteArray("json");
+    }
+
+    // intern the whole dataset into a fresh pool, mostly duplicates
+    Q_NEVER_INLINE void benchIntern()
+    {
+        QFETCH(QByteArray, dataset);
+        const QVector<QString> strings = makeDataset(dataset);
+
+        {
+            StringPool pool;
+            QVector<Atom> atoms;
+            atoms.reserve(strings.size());
+            size_t stringsMemory = strings.size() * sizeof(QString);
+            for (const QString& string : strings) {
+                atoms << pool.intern(string);
+                stringsMemory += StringPool::stringMemoryUsage(string);
+            }
+            const size_t atomsMemory = atoms.size() * sizeof(Atom) + pool.memoryUsage();
+            qDebug("%d strings, %d distinct: %zu bytes as QStrings, %zu bytes as atoms (%.1f%% saved)",
+                   strings.size(), pool.size(), stringsMemory, atomsMemory,
+                   100. * (1. - static_cast<double>(atomsMemory) / stringsMemory));
+        }
+
+        QBENCHMARK {
+            StringPool pool;
+            for (const QString& string : strings) {
+                Atom atom = pool.intern(string);
+                escape(&atom);
+            }
+        }
+    }
+
+    Q_NEVER_INLINE void benchInternConcurrent_data()
+    {
+        QTest::addColumn<int>("threads");
+        for (int threads : threadCounts()) {
+            QTest::newRow(qPrintable(QString::number(threads))) << threads;
+        }
+    }
+
+    // intern the json dataset on all threads into a pool which already contains it
+    Q_NEVER_INLINE void benchInternConcurrent()
+    {
+        QFETCH(int, threads);
+        const QVector<QString> strings = makeDataset("json");
+        StringPool pool;
+        for (const QString& string : strings) {
+            pool.intern(string);
+        }
+
+        const qint64 elapsed = runThreads(threads, [&](int) {
+            for (const QString& string : strings) {
+                Atom atom = pool.intern(string);
+                escape(&atom);
+            }
+        });
+        QTest::setBenchmarkResult(static_cast<qreal>(elapsed) / (static_cast<qint64>(threads) * strings.size()),
+                                  QTest::WalltimeNanoseconds);
+    }
+
+    Q_NEVER_INLINE void benchInternConcurrentLocked_data()
+    {
+        benchInternConcurrent_data();
+    }
+
+    // like benchInternConcurrent, but with a QHash guarded by a QReadWriteLock
+    Q_NEVER_INLINE void benchInternConcurrentLocked()
+    {
+        QFETCH(int, threads);
+        const QVector<QString> strings = makeDataset("json");
+        QHash<QString, int> pool;
+        QReadWriteLock lock;
+        auto intern = [&](const QString& string) -> int {
+            {
+                QReadLocker locker(&lock);
+                auto it = pool.constFind(string);
+                if (it != pool.constEnd()) {
+                    return it.value();
+                }
+            }
+            QWriteLocker locker(&lock);
+            auto it = pool.find(string);
+            if (it == pool.end()) {
+                it = pool.insert(string, pool.size());
+            }
+            return it.value();
+        };
+        for (const QString& string : strings) {
+            intern(string);
+        }
+
+        const qint64 elapsed = runThreads(threads, [&](int) {
+            for (const QString& string : strings) {
+                int atom = intern(string);
+                escape(&atom);
+            }
+        });
+        QTest::setBenchmarkResult(static_cast<qreal>(elapsed) / (static_cast<qint64>(threads) * strings.size()),
+                                  QTest::WalltimeNanoseconds);
+    }
+
     Q_NEVER_INLINE void benchQStringContains()
     {
         const QString foo = QStringLiteral("foobarasdf");
@@ -174,6 +844,155 @@ private slots:
         }
     }
 
+    Q_NEVER_INLINE void benchSearch_data()
+    {
+        QTest::addColumn<int>("haystackSize");
+        QTest::addColumn<int>("needleSize");
+        const QPair<const char*, int> haystackSizes[] = {
+            {"16B", 16}, {"1K", 1024}, {"64K", 64 * 1024}, {"1M", 1024 * 1024}, {"64M", 64 * 1024 * 1024}
+        };
+        for (const auto& haystackSize : haystackSizes) {
+            for (int needleSize : {1, 4, 16, 64}) {
+                if (needleSize * 2 > haystackSize.second) {
+                    continue;
+                }
+                QTest::newRow(qPrintable(QStringLiteral("%1/%2").arg(QLatin1String(haystackSize.first)).arg(needleSize)))
+                    << haystackSize.second << needleSize;
+            }
+        }
+    }
+
+    Q_NEVER_INLINE void benchSearchIndexOf_data()
+    {
+        benchSearch_data();
+    }
+
+    Q_NEVER_INLINE void benchSearchIndexOf()
+    {
+        QFETCH(int, haystackSize);
+        QFETCH(int, needleSize);
+        const QString needle = makeNeedle(needleSize);
+        const QString& haystack = makeHaystack(haystackSize, needle);
+        benchSearch(haystack, needle, [&] { return haystack.indexOf(needle); });
+    }
+
+    Q_NEVER_INLINE void benchSearchMatcher_data()
+    {
+        benchSearch_data();
+    }
+
+    Q_NEVER_INLINE void benchSearchMatcher()
+    {
+        QFETCH(int, haystackSize);
+        QFETCH(int, needleSize);
+        const QString needle = makeNeedle(needleSize);
+        const QString& haystack = makeHaystack(haystackSize, needle);
+        const QStringMatcher matcher(needle);
+        benchSearch(haystack, needle, [&] { return matcher.indexIn(haystack); });
+    }
+
+    Q_NEVER_INLINE void benchSearchSimd_data()
+    {
+        benchSearch_data();
+    }
+
+    Q_NEVER_INLINE void benchSearchSimd()
+    {
+        QFETCH(int, haystackSize);
+        QFETCH(int, needleSize);
+        const QString needle = makeNeedle(needleSize);
+        const QString& haystack = makeHaystack(haystackSize, needle);
+        benchSearch(haystack, needle, [&] { return StringSearch::indexOf(haystack, needle); });
+    }
+
+    Q_NEVER_INLINE void benchSearchTwoWay_data()
+    {
+        benchSearch_data();
+    }
+
+    Q_NEVER_INLINE void benchSearchTwoWay()
+    {
+        QFETCH(int, haystackSize);
+        QFETCH(int, needleSize);
+        const QString needle = makeNeedle(needleSize);
+        const QString& haystack = makeHaystack(haystackSize, needle);
+        const StringSearch::TwoWay searcher(needle);
+        benchSearch(haystack, needle, [&] { return searcher.indexIn(haystack); });
+    }
+
+    Q_NEVER_INLINE void benchSearchHorspool_data()
+    {
+        benchSearch_data();
+    }
+
+    Q_NEVER_INLINE void benchSearchHorspool()
+    {
+        QFETCH(int, haystackSize);
+        QFETCH(int, needleSize);
+        const QString needle = makeNeedle(needleSize);
+        const QString& haystack = makeHaystack(haystackSize, needle);
+        const StringSearch::Horspool searcher(needle);
+        benchSearch(haystack, needle, [&] { return searcher.indexIn(haystack); });
+    }
+
+    Q_NEVER_INLINE void benchMultiSearch_data()
+    {
+        QTest::addColumn<int>("numPatterns");
+        for (int numPatterns : {1, 10, 100}) {
+            QTest::newRow(qPrintable(QString::number(numPatterns))) << numPatterns;
+        }
+    }
+
+    Q_NEVER_INLINE void benchMultiSearchMatchers_data()
+    {
+        benchMultiSearch_data();
+    }
+
+    // count all occurrences of any of the patterns in 1MB of text, one pattern at a time
+    Q_NEVER_INLINE void benchMultiSearchMatchers()
+    {
+        QFETCH(int, numPatterns);
+        const QString& haystack = makeHaystack(1024 * 1024, QString());
+        QVector<QStringMatcher> matchers;
+        for (const QString& pattern : makePatterns(numPatterns)) {
+            matchers << QStringMatcher(pattern);
+        }
+        QBENCHMARK {
+            int matches = 0;
+            for (const QStringMatcher& matcher : matchers) {
+                for (int from = matcher.indexIn(haystack); from != -1; from = matcher.indexIn(haystack, from + 1)) {
+                    ++matches;
+                }
+            }
+            escape(&matches);
+        }
+    }
+
+    Q_NEVER_INLINE void benchMultiSearchAhoCorasick_data()
+    {
+        benchMultiSearch_data();
+    }
+
+    // count all occurrences of any of the patterns in 1MB of text in a single pass
+    Q_NEVER_INLINE void benchMultiSearchAhoCorasick()
+    {
+        QFETCH(int, numPatterns);
+        const QString& haystack = makeHaystack(1024 * 1024, QString());
+        const QStringList patterns = makePatterns(numPatterns);
+        const StringSearch::AhoCorasick automaton(patterns);
+
+        int expected = 0;
+        for (const QString& pattern : patterns) {
+            expected += haystack.count(pattern);
+        }
+        QCOMPARE(automaton.count(haystack), expected);
+
+        QBENCHMARK {
+            int matches = automaton.count(haystack);
+            escape(&matches);
+        }
+    }
+
     Q_NEVER_INLINE void benchQStringConcatSlow()
     {
         const QString foo = QStringLiteral("foo");
@@ -225,6 +1044,170 @@ private slots:
         }
     }
 
+    Q_NEVER_INLINE void benchFormat_data()
+    {
+        QTest::addColumn<int>("placeholders");
+        QTest::newRow("3") << 3;
+        QTest::newRow("10") << 10;
+        QTest::newRow("30") << 30;
+    }
+
+    Q_NEVER_INLINE void benchFormatArgChain_data()
+    {
+        benchFormat_data();
+    }
+
+    Q_NEVER_INLINE void benchFormatArgChain()
+    {
+        QFETCH(int, placeholders);
+        const QString pattern = formatPattern(placeholders);
+        benchFormat([&pattern](const QVector<QString>& arguments, const QVector<const QString*>&) {
+            QString result = pattern;
+            for (const QString& argument : arguments) {
+                result = result.arg(argument);
+            }
+            return result;
+        });
+    }
+
+    Q_NEVER_INLINE void benchFormatMultiArg_data()
+    {
+        benchFormat_data();
+    }
+
+    Q_NEVER_INLINE void benchFormatMultiArg()
+    {
+        QFETCH(int, placeholders);
+        const QString pattern = formatPattern(placeholders);
+        benchFormat([&pattern](const QVector<QString>& arguments, const QVector<const QString*>&) {
+            return multiArg(pattern, arguments);
+        });
+    }
+
+    Q_NEVER_INLINE void benchFormatBuilder_data()
+    {
+        benchFormat_data();
+    }
+
+    Q_NEVER_INLINE void benchFormatBuilder()
+    {
+        QFETCH(int, placeholders);
+        QVector<QString> literals;
+        for (int i = 0; i < placeholders; ++i) {
+            literals << formatLiteral(i);
+        }
+        benchFormat([&literals](const QVector<QString>& arguments, const QVector<const QString*>&) {
+            return concatenate(literals, arguments);
+        });
+    }
+
+    Q_NEVER_INLINE void benchFormatTemplate_data()
+    {
+        benchFormat_data();
+    }
+
+    Q_NEVER_INLINE void benchFormatTemplate()
+    {
+        QFETCH(int, placeholders);
+        const FormatTemplate format(formatPattern(placeholders));
+        QCOMPARE(format.argumentCount(), placeholders);
+        benchFormat([&format](const QVector<QString>&, const QVector<const QString*>& pointers) {
+            return format.format(pointers.constData(), pointers.size());
+        });
+    }
+
+    Q_NEVER_INLINE void benchFormatStatic_data()
+    {
+        benchFormat_data();
+    }
+
+    Q_NEVER_INLINE void benchFormatStatic()
+    {
+        QFETCH(int, placeholders);
+        benchFormat([placeholders](const QVector<QString>&, const QVector<const QString*>& pointers) {
+            switch (placeholders) {
+            case 3:
+                return STATIC_FORMAT_3.format(pointers.constData(), pointers.size());
+            case 10:
+                return STATIC_FORMAT_10.format(pointers.constData(), pointers.size());
+            case 30:
+                return STATIC_FORMAT_30.format(pointers.constData(), pointers.size());
+            }
+            return QString();
+        });
+    }
+
+    Q_NEVER_INLINE void benchStringBuilder_data()
+    {
+        QTest::addColumn<int>("fragments");
+        QTest::addColumn<int>("appends");
+
+        const QPair<const char*, int> kinds[] = {
+            {"latin1", Latin1Fragments},
+            {"utf16", Utf16Fragments},
+            {"numbers", NumberFragments},
+            {"mixed", MixedFragments}
+        };
+        for (const auto& kind : kinds) {
+            for (int appends : {10, 1000, 100000}) {
+                QTest::newRow(qPrintable(QStringLiteral("%1/%2").arg(QLatin1String(kind.first)).arg(appends)))
+                    << kind.second << appends;
+            }
+        }
+        // a multi-MB report
+        QTest::newRow("mixed/1000000") << int(MixedFragments) << 1000000;
+    }
+
+    Q_NEVER_INLINE void benchStringBuilderQString_data()
+    {
+        benchStringBuilder_data();
+    }
+
+    Q_NEVER_INLINE void benchStringBuilderQString()
+    {
+        benchStringBuilder<QStringAppender>();
+    }
+
+    Q_NEVER_INLINE void benchStringBuilderInline_data()
+    {
+        benchStringBuilder_data();
+    }
+
+    Q_NEVER_INLINE void benchStringBuilderInline()
+    {
+        benchStringBuilder<InlineStringBuilder<256>>();
+    }
+
+    Q_NEVER_INLINE void benchStringBuilderInlineView_data()
+    {
+        benchStringBuilder_data();
+    }
+
+    // like benchStringBuilderInline, but without materializing a QString
+    Q_NEVER_INLINE void benchStringBuilderInlineView()
+    {
+        QFETCH(int, fragments);
+        QFETCH(int, appends);
+        const Fragments input;
+        std::unique_ptr<InlineStringBuilder<256>> builder(new InlineStringBuilder<256>);
+        QBENCHMARK {
+            builder->clear();
+            input.appendTo(*builder, fragments, appends);
+            QStringView view = builder->view();
+            escape(&view);
+        }
+    }
+
+    Q_NEVER_INLINE void benchStringBuilderArena_data()
+    {
+        benchStringBuilder_data();
+    }
+
+    Q_NEVER_INLINE void benchStringBuilderArena()
+    {
+        benchStringBuilder<ArenaStringBuilder>();
+    }
+
     Q_NEVER_INLINE void benchQStringMid()
     {
         const QString needle = QStringLiteral("foo");
@@ -286,8 +1269,259 @@ private slots:
             escape(qFastUtf8Printable_QUtf8Functions(64, string));
         }
     }
+
+    Q_NEVER_INLINE void benchQFastUtf8Printable_SIMD()
+    {
+        const QString string = QStringLiteral("123456789012345678901234567890");
+        QBENCHMARK {
+            escape(qFastUtf8Printable_SIMD(64, string));
+        }
+    }
+
+    Q_NEVER_INLINE void benchUtf8PrintableCrossover_data()
+    {
+        QTest::addColumn<QString>("string");
+
+        // qFastUtf8Printable switches to the scratch buffers above 85 characters
+        const QString sample = QStringLiteral("The quick brown fox jumps over the lazy dog. ");
+        for (int size : {16, 64, 85, 86, 128, 256, 1024, 4096}) {
+            QTest::newRow(qPrintable(QString::number(size))) << repeatToUtf8Size(sample, size);
+        }
+    }
+
+    Q_NEVER_INLINE void benchQUtf8PrintableCrossover_data()
+    {
+        benchUtf8PrintableCrossover_data();
+    }
+
+    Q_NEVER_INLINE void benchQUtf8PrintableCrossover()
+    {
+        QFETCH(QString, string);
+        QBENCHMARK {
+            escape(qUtf8Printable(string));
+        }
+    }
+
+    Q_NEVER_INLINE void benchQFastUtf8PrintableCrossover_data()
+    {
+        benchUtf8PrintableCrossover_data();
+    }
+
+    Q_NEVER_INLINE void benchQFastUtf8PrintableCrossover()
+    {
+        QFETCH(QString, string);
+        QCOMPARE(QByteArray(qFastUtf8Printable(string)), string.toUtf8());
+        QBENCHMARK {
+            escape(qFastUtf8Printable(string));
+        }
+    }
+
+    Q_NEVER_INLINE void benchBatchToUtf8_data()
+    {
+        QTest::addColumn<QStringList>("strings");
+        QTest::newRow("ascii") << makeBatch(QStringLiteral("The quick brown fox jumps over the lazy dog. "));
+        QTest::newRow("latin1") << makeBatch(QString::fromUtf8("Größere Äpfel für Çédric à Málaga, señor! "));
+        QTest::newRow("cjk") << makeBatch(QString::fromUtf8("日本語の文章と中文的句子，한국어 문장도。"));
+        QTest::newRow("emoji") << makeBatch(QString::fromUtf8("😀🎉👍🏽🚀🔥 ok 🙈🙉🙊 "));
+    }
+
+    // all batch benchmarks report their throughput in bytes of UTF-8 or Latin-1 per second
+    Q_NEVER_INLINE void benchBatchToUtf8()
+    {
+        QFETCH(QStringList, strings);
+        const QVector<QString> input = strings.toVector();
+        StringBatch batch(StringBatch::Utf8);
+        batch.append(input.constData(), input.constData() + input.size());
+        QCOMPARE(QByteArray(batch.data(), batch.size()), strings.join(QString()).toUtf8());
+
+        BenchStats::reportThroughput(BenchStats::measure(batch.size(), [&] {
+            batch.clear();
+            batch.append(input.constData(), input.constData() + input.size());
+            escape(batch.data());
+        }));
+    }
+
+    Q_NEVER_INLINE void benchToUtf8Loop_data()
+    {
+        benchBatchToUtf8_data();
+    }
+
+    Q_NEVER_INLINE void benchToUtf8Loop()
+    {
+        QFETCH(QStringList, strings);
+        const QVector<QString> input = strings.toVector();
+        const int bytes = strings.join(QString()).toUtf8().size();
+        QByteArray buffer;
+        buffer.reserve(bytes);
+        std::vector<int> offsets;
+        offsets.reserve(input.size() + 1);
+
+        BenchStats::reportThroughput(BenchStats::measure(bytes, [&] {
+            buffer.resize(0);
+            offsets.assign(1, 0);
+            for (const QString& string : input) {
+                buffer += string.toUtf8();
+                offsets.push_back(buffer.size());
+            }
+            escape(buffer.constData());
+        }));
+    }
+
+    Q_NEVER_INLINE void benchBatchToLatin1_data()
+    {
+        QTest::addColumn<QStringList>("strings");
+        QTest::newRow("ascii") << makeBatch(QStringLiteral("The quick brown fox jumps over the lazy dog. "));
+        QTest::newRow("latin1") << makeBatch(QString::fromUtf8("Größere Äpfel für Çédric à Málaga, señor! "));
+    }
+
+    Q_NEVER_INLINE void benchBatchToLatin1()
+    {
+        QFETCH(QStringList, strings);
+        const QVector<QString> input = strings.toVector();
+        StringBatch batch(StringBatch::Latin1);
+        batch.append(input.constData(), input.constData() + input.size());
+        QCOMPARE(QByteArray(batch.data(), batch.size()), strings.join(QString()).toLatin1());
+
+        BenchStats::reportThroughput(BenchStats::measure(batch.size(), [&] {
+            batch.clear();
+            batch.append(input.constData(), input.constData() + input.size());
+            escape(batch.data());
+        }));
+    }
+
+    Q_NEVER_INLINE void benchToLatin1Loop_data()
+    {
+        benchBatchToLatin1_data();
+    }
+
+    Q_NEVER_INLINE void benchToLatin1Loop()
+    {
+        QFETCH(QStringList, strings);
+        const QVector<QString> input = strings.toVector();
+        const int bytes = strings.join(QString()).size();
+        QByteArray buffer;
+        buffer.reserve(bytes);
+        std::vector<int> offsets;
+        offsets.reserve(input.size() + 1);
+
+        BenchStats::reportThroughput(BenchStats::measure(bytes, [&] {
+            buffer.resize(0);
+            offsets.assign(1, 0);
+            for (const QString& string : input) {
+                buffer += string.toLatin1();
+                offsets.push_back(buffer.size());
+            }
+            escape(buffer.constData());
+        }));
+    }
+
+    Q_NEVER_INLINE void benchBatchFromUtf8_data()
+    {
+        benchBatchToUtf8_data();
+    }
+
+    Q_NEVER_INLINE void benchBatchFromUtf8()
+    {
+        QFETCH(QStringList, strings);
+        StringBatch batch(StringBatch::Utf8);
+        batch.append(strings);
+        QVector<QString> output;
+        batch.toStrings(&output);
+        QCOMPARE(output, strings.toVector());
+
+        BenchStats::reportThroughput(BenchStats::measure(batch.size(), [&] {
+            batch.toStrings(&output);
+            escape(output.constData());
+        }));
+    }
+
+    Q_NEVER_INLINE void benchFromUtf8Loop_data()
+    {
+        benchBatchToUtf8_data();
+    }
+
+    Q_NEVER_INLINE void benchFromUtf8Loop()
+    {
+        QFETCH(QStringList, strings);
+        StringBatch batch(StringBatch::Utf8);
+        batch.append(strings);
+        QVector<QString> output(batch.count());
+
+        BenchStats::reportThroughput(BenchStats::measure(batch.size(), [&] {
+            for (int i = 0; i < batch.count(); ++i) {
+                output[i] = QString::fromUtf8(batch.at(i), batch.length(i));
+            }
+            escape(output.constData());
+        }));
+    }
+
+    Q_NEVER_INLINE void benchUtf8Conversion_data()
+    {
+        QTest::addColumn<QString>("string");
+
+        const QPair<const char*, QString> samples[] = {
+            {"ascii", QStringLiteral("The quick brown fox jumps over the lazy dog. ")},
+            {"latin1", QString::fromUtf8("Größere Äpfel für Çédric à Málaga, señor! ")},
+            {"cjk", QString::fromUtf8("日本語の文章と中文的句子，한국어 문장도。")},
+            {"emoji", QString::fromUtf8("😀🎉👍🏽🚀🔥 ok 🙈🙉🙊 ")}
+        };
+        for (const auto& sample : samples) {
+            for (int size : {30, 1024, 32 * 1024, 1024 * 1024}) {
+                QTest::newRow(qPrintable(QStringLiteral("%1/%2").arg(QLatin1String(sample.first)).arg(size)))
+                    << repeatToUtf8Size(sample.second, size);
+            }
+        }
+    }
+
+    Q_NEVER_INLINE void benchUtf8Conversion()
+    {
+        QFETCH(QString, string);
+        QBENCHMARK {
+            escape(qUtf8Printable(string));
+        }
+    }
+
+    Q_NEVER_INLINE void benchUtf8Conversion_codecvt_data()
+    {
+        benchUtf8Conversion_data();
+    }
+
+    Q_NEVER_INLINE void benchUtf8Conversion_codecvt()
+    {
+        benchConverter<ConvertQStringToUtf8_codecvt<MAX_CONVERSION_SIZE>>();
+    }
+
+    Q_NEVER_INLINE void benchUtf8Conversion_ICU_data()
+    {
+        benchUtf8Conversion_data();
+    }
+
+    Q_NEVER_INLINE void benchUtf8Conversion_ICU()
+    {
+        benchConverter<ConvertQStringToUtf8_ICU<MAX_CONVERSION_SIZE>>();
+    }
+
+    Q_NEVER_INLINE void benchUtf8Conversion_QUtf8Functions_data()
+    {
+        benchUtf8Conversion_data();
+    }
+
+    Q_NEVER_INLINE void benchUtf8Conversion_QUtf8Functions()
+    {
+        benchConverter<ConvertQStringToUtf8_QUtf8Functions<MAX_CONVERSION_SIZE>>();
+    }
+
+    Q_NEVER_INLINE void benchUtf8Conversion_SIMD_data()
+    {
+        benchUtf8Conversion_data();
+    }
+
+    Q_NEVER_INLINE void benchUtf8Conversion_SIMD()
+    {
+        benchConverter<ConvertQStringToUtf8_SIMD<MAX_CONVERSION_SIZE>>();
+    }
 };
 
-QTEST_GUILESS_MAIN(BenchQString)
+BENCH_QT_GUILESS_MAIN(BenchQString)
 
 #include "bench_qstring.moc"
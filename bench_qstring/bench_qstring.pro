@@ -1,7 +1,7 @@
 TEMPLATE = app
 
 QT += testlib core_private
-CONFIG += c++11 testcase release
+CONFIG += c++1z testcase release
 
 LIBS += -licuuc
 
@@ -9,4 +9,11 @@ linux|mac {
     QMAKE_CXXFLAGS += -g
 }
 
+HEADERS = utf8simd.h \
+          stringbatch.h \
+          stringsearch.h \
+          stringpool.h \
+          formattemplate.h \
+          stringbuilder.h
+
 SOURCES = bench_qstring.cpp
@@ -0,0 +1,235 @@
+/**
+ *
+ * Copyright (C) 2015 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com, author Milian Wolff <milian.wolff@kdab.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef BENCH_QT_FORMATTEMPLATE_H
+#define BENCH_QT_FORMATTEMPLATE_H
+
+#include <QString>
+#include <QVector>
+
+#include <cstring>
+
+/**
+ * A part of a parsed format pattern: a literal followed by a placeholder.
+ *
+ * The placeholders are %1 to %99 like for QString::arg, where %N refers to the
+ * N-th argument. The last segment of a pattern may have no placeholder.
+ */
+struct FormatSegment
+{
+    int literalStart = 0;
+    int literalLength = 0;
+    // the zero based index of the argument, or -1
+    int argument = -1;
+    // where the placeholder itself is, used when an argument is missing
+    int placeholderStart = 0;
+    int placeholderLength = 0;
+};
+
+/**
+ * Parse @p pattern of @p size characters into @p segments, which needs space
+ * for size + 1 entries.
+ *
+ * @return the number of segments
+ */
+template<typename Char>
+constexpr int parseFormat(const Char* pattern, int size, FormatSegment* segments, int* literalSize, int* argumentCount)
+{
+    int numSegments = 0;
+    int literalStart = 0;
+    *literalSize = 0;
+    *argumentCount = 0;
+    for (int i = 0; i < size; ++i) {
+        if (pattern[i] != '%' || i + 1 >= size || pattern[i + 1] < '0' || pattern[i + 1] > '9') {
+            continue;
+        }
+        int number = pattern[i + 1] - '0';
+        int length = 2;
+        if (i + 2 < size && pattern[i + 2] >= '0' && pattern[i + 2] <= '9') {
+            number = number * 10 + (pattern[i + 2] - '0');
+            length = 3;
+        }
+        if (!number) {
+            continue;
+        }
+        FormatSegment& segment = segments[numSegments++];
+        segment.literalStart = literalStart;
+        segment.literalLength = i - literalStart;
+        segment.argument = number - 1;
+        segment.placeholderStart = i;
+        segment.placeholderLength = length;
+        *literalSize += segment.literalLength;
+        *argumentCount = number > *argumentCount ? number : *argumentCount;
+        literalStart = i + length;
+        i += length - 1;
+    }
+    if (literalStart < size) {
+        FormatSegment& segment = segments[numSegments++];
+        segment.literalStart = literalStart;
+        segment.literalLength = size - literalStart;
+        segment.argument = -1;
+        *literalSize += segment.literalLength;
+    }
+    return numSegments;
+}
+
+/**
+ * Fill the parsed @p segments of @p pattern with @p count @p arguments.
+ *
+ * The exact output size is computed up front, such that the result is built
+ * with a single allocation. Placeholders without an argument are kept as is.
+ */
+inline QString formatSegments(const ushort* pattern, const FormatSegment* segments, int numSegments, int literalSize,
+                              const QString* const* arguments, int count)
+{
+    int size = literalSize;
+    for (int i = 0; i < numSegments; ++i) {
+        const FormatSegment& segment = segments[i];
+        if (segment.argument >= count) {
+            size += segment.placeholderLength;
+        } else if (segment.argument != -1) {
+            size += arguments[segment.argument]->size();
+        }
+    }
+
+    QString result(size, Qt::Uninitialized);
+    ushort* out = reinterpret_cast<ushort*>(result.data());
+    auto append = [&out](const ushort* data, int length) {
+        memcpy(out, data, static_cast<size_t>(length) * sizeof(ushort));
+        out += length;
+    };
+    for (int i = 0; i < numSegments; ++i) {
+        const FormatSegment& segment = segments[i];
+        append(pattern + segment.literalStart, segment.literalLength);
+        if (segment.argument >= count) {
+            append(pattern + segment.placeholderStart, segment.placeholderLength);
+        } else if (segment.argument != -1) {
+            const QString& argument = *arguments[segment.argument];
+            append(reinterpret_cast<const ushort*>(argument.constData()), argument.size());
+        }
+    }
+    return result;
+}
+
+/**
+ * A format pattern which is parsed once and can then be filled many times.
+ *
+ * Unlike QString::arg, the arguments always refer to %1 ... %N by number, and
+ * they are not scanned for placeholders again.
+ */
+class FormatTemplate
+{
+public:
+    explicit FormatTemplate(const QString& pattern)
+        : m_pattern(pattern)
+        , m_segments(pattern.size() + 1)
+    {
+        m_segments.resize(parseFormat(reinterpret_cast<const ushort*>(pattern.constData()), pattern.size(), m_segments.data(),
+                                      &m_literalSize, &m_argumentCount));
+    }
+
+    // the highest placeholder number
+    int argumentCount() const
+    {
+        return m_argumentCount;
+    }
+
+    QString format(const QString* const* arguments, int count) const
+    {
+        return formatSegments(reinterpret_cast<const ushort*>(m_pattern.constData()), m_segments.constData(),
+                              m_segments.size(), m_literalSize, arguments, count);
+    }
+
+    template<typename... Args>
+    QString operator()(const Args&... args) const
+    {
+        const QString* arguments[] = {&args...};
+        return format(arguments, sizeof...(Args));
+    }
+
+private:
+    QString m_pattern;
+    QVector<FormatSegment> m_segments;
+    int m_literalSize = 0;
+    int m_argumentCount = 0;
+};
+
+/**
+ * Like FormatTemplate, but parsed at compile time from a UTF-16 literal,
+ * see staticFormat().
+ */
+template<int N>
+class StaticFormatTemplate
+{
+public:
+    constexpr explicit StaticFormatTemplate(const char16_t (&pattern)[N])
+        : m_pattern(pattern)
+    {
+        // N includes the null terminator
+        m_numSegments = parseFormat(pattern, N - 1, m_segments, &m_literalSize, &m_argumentCount);
+    }
+
+    constexpr int argumentCount() const
+    {
+        return m_argumentCount;
+    }
+
+    QString format(const QString* const* arguments, int count) const
+    {
+        return formatSegments(reinterpret_cast<const ushort*>(m_pattern), m_segments, m_numSegments, m_literalSize,
+                              arguments, count);
+    }
+
+    template<typename... Args>
+    QString operator()(const Args&... args) const
+    {
+        const QString* arguments[] = {&args...};
+        return format(arguments, sizeof...(Args));
+    }
+
+private:
+    const char16_t* m_pattern;
+    FormatSegment m_segments[N] = {};
+    int m_numSegments = 0;
+    int m_literalSize = 0;
+    int m_argumentCount = 0;
+};
+
+// e.g. constexpr auto format = staticFormat(u"%1: %2"); static_assert(format.argumentCount() == 2, "");
+template<int N>
+constexpr StaticFormatTemplate<N> staticFormat(const char16_t (&pattern)[N])
+{
+    return StaticFormatTemplate<N>(pattern);
+}
+
+#endif
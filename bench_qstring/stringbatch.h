@@ -0,0 +1,266 @@
+/**
+ *
+ * Copyright (C) 2015 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com, author Milian Wolff <milian.wolff@kdab.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef BENCH_QT_STRINGBATCH_H
+#define BENCH_QT_STRINGBATCH_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include <algorithm>
+#include <vector>
+
+#include "utf8simd.h"
+
+/**
+ * Many strings transcoded into a single contiguous buffer.
+ *
+ * Instead of one QByteArray per string, all strings are encoded back to back
+ * into one buffer and an offsets array marks where each of them starts, such
+ * that the result can be written into a network or disk buffer as is. The
+ * buffer is grown geometrically and kept across clear(), so encoding batch after
+ * batch does not allocate in steady state.
+ *
+ * fromEncoded() and toStrings() go the other way.
+ */
+class StringBatch
+{
+public:
+    enum Encoding
+    {
+        Utf8,
+        Latin1
+    };
+
+    explicit StringBatch(Encoding encoding = Utf8)
+        : m_encoding(encoding)
+    {
+        m_offsets.push_back(0);
+    }
+
+    Encoding encoding() const
+    {
+        return m_encoding;
+    }
+
+    // removes all strings but keeps the memory around
+    void clear()
+    {
+        m_size = 0;
+        m_offsets.resize(1);
+    }
+
+    void append(const QString& string)
+    {
+        reserveFor(string.size());
+        encode(string);
+    }
+
+    void append(const QString* begin, const QString* end)
+    {
+        int units = 0;
+        for (auto it = begin; it != end; ++it) {
+            units += it->size();
+        }
+        reserveFor(units);
+        m_offsets.reserve(m_offsets.size() + (end - begin));
+        for (auto it = begin; it != end; ++it) {
+            encode(*it);
+        }
+    }
+
+    void append(const QStringList& strings)
+    {
+        // QStringList is not contiguous, append one by one after reserving once
+        int units = 0;
+        for (const QString& string : strings) {
+            units += string.size();
+        }
+        reserveFor(units);
+        for (const QString& string : strings) {
+            encode(string);
+        }
+    }
+
+    // the number of strings in the batch
+    int count() const
+    {
+        return static_cast<int>(m_offsets.size()) - 1;
+    }
+
+    const char* data() const
+    {
+        return m_data.data();
+    }
+
+    // the number of bytes of all encoded strings
+    int size() const
+    {
+        return m_size;
+    }
+
+    // count() + 1 offsets into data(), the last one being size()
+    const std::vector<int>& offsets() const
+    {
+        return m_offsets;
+    }
+
+    const char* at(int i) const
+    {
+        return m_data.data() + m_offsets[i];
+    }
+
+    int length(int i) const
+    {
+        return m_offsets[i + 1] - m_offsets[i];
+    }
+
+    /**
+     * Replace the contents with @p size bytes of already encoded @p data and
+     * the @p offsets of the strings in it, e.g. as read back from disk.
+     */
+    void fromEncoded(const char* data, int size, const std::vector<int>& offsets)
+    {
+        m_data.assign(data, data + size);
+        m_size = size;
+        m_offsets = offsets;
+    }
+
+    QString toString(int i) const
+    {
+        if (m_encoding == Latin1) {
+            return QString::fromLatin1(at(i), length(i));
+        }
+        const int size = length(i);
+        const uchar* src = reinterpret_cast<const uchar*>(at(i));
+        if (!isAscii(src, size)) {
+            return QString::fromUtf8(at(i), size);
+        }
+        QString string(size, Qt::Uninitialized);
+        widenAscii(src, size, reinterpret_cast<ushort*>(string.data()));
+        return string;
+    }
+
+    // decode all strings into @p strings, replacing its contents, every string is a new allocation
+    void toStrings(QVector<QString>* strings) const
+    {
+        strings->resize(count());
+        for (int i = 0; i < count(); ++i) {
+            (*strings)[i] = toString(i);
+        }
+    }
+
+private:
+    void reserveFor(int units)
+    {
+        // a UTF-16 code unit never takes more than three bytes in UTF-8
+        const size_t needed = static_cast<size_t>(m_size) + static_cast<size_t>(units) * (m_encoding == Utf8 ? 3 : 1);
+        if (needed > m_data.size()) {
+            m_data.resize(std::max(needed, m_data.size() * 2));
+        }
+    }
+
+    void encode(const QString& string)
+    {
+        char* dst = m_data.data() + m_size;
+        if (m_encoding == Utf8) {
+            m_size += Utf8Simd::convert(string.utf16(), string.size(), dst, static_cast<int>(m_data.size()) - m_size);
+        } else {
+            toLatin1(string.utf16(), string.size(), reinterpret_cast<uchar*>(dst));
+            m_size += string.size();
+        }
+        m_offsets.push_back(m_size);
+    }
+
+    // like QString::toLatin1, characters outside of Latin-1 become '?'
+    static void toLatin1(const ushort* src, int size, uchar* dst)
+    {
+        int i = 0;
+#ifdef HAVE_UTF8_SIMD
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i highByte = _mm_set1_epi16(static_cast<short>(0xff00));
+        for (; i + 8 <= size; i += 8) {
+            const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(chunk, highByte), zero)) != 0xffff) {
+                break;
+            }
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(chunk, chunk));
+        }
+#endif
+        for (; i < size; ++i) {
+            dst[i] = src[i] > 0xff ? '?' : static_cast<uchar>(src[i]);
+        }
+    }
+
+    static bool isAscii(const uchar* src, int size)
+    {
+        int i = 0;
+#ifdef HAVE_UTF8_SIMD
+        for (; i + 16 <= size; i += 16) {
+            if (_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)))) {
+                return false;
+            }
+        }
+#endif
+        for (; i < size; ++i) {
+            if (src[i] & 0x80) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static void widenAscii(const uchar* src, int size, ushort* dst)
+    {
+        int i = 0;
+#ifdef HAVE_UTF8_SIMD
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 16 <= size; i += 16) {
+            const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi8(chunk, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), _mm_unpackhi_epi8(chunk, zero));
+        }
+#endif
+        for (; i < size; ++i) {
+            dst[i] = src[i];
+        }
+    }
+
+    Encoding m_encoding;
+    std::vector<char> m_data;
+    int m_size = 0;
+    std::vector<int> m_offsets;
+};
+
+#endif
@@ -0,0 +1,336 @@
+/**
+ *
+ * Copyright (C) 2015 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com, author Milian Wolff <milian.wolff@kdab.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef BENCH_QT_STRINGBUILDER_H
+#define BENCH_QT_STRINGBUILDER_H
+
+#include <QString>
+#include <QStringView>
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+/**
+ * Write the decimal representation of @p value to @p out, which needs space
+ * for at least 20 characters.
+ *
+ * @return the number of characters written
+ */
+inline int formatDecimal(qlonglong value, ushort* out)
+{
+    // two digits at a time, to halve the number of divisions
+    static const char DIGIT_PAIRS[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+
+    const bool negative = value < 0;
+    qulonglong magnitude = negative ? 0 - static_cast<qulonglong>(value) : static_cast<qulonglong>(value);
+    ushort buffer[20];
+    ushort* end = buffer + 20;
+    ushort* pos = end;
+    while (magnitude >= 100) {
+        const char* pair = DIGIT_PAIRS + (magnitude % 100) * 2;
+        magnitude /= 100;
+        *--pos = pair[1];
+        *--pos = pair[0];
+    }
+    if (magnitude >= 10) {
+        const char* pair = DIGIT_PAIRS + magnitude * 2;
+        *--pos = pair[1];
+        *--pos = pair[0];
+    } else {
+        *--pos = static_cast<ushort>('0' + magnitude);
+    }
+    int length = 0;
+    if (negative) {
+        out[length++] = '-';
+    }
+    memcpy(out + length, pos, (end - pos) * sizeof(ushort));
+    return length + (end - pos);
+}
+
+/**
+ * The appending interface shared by the string builders below.
+ *
+ * Derived classes provide ushort* appendSpace(int size), which returns
+ * contiguous space for @p size characters at the end of the string.
+ */
+template<typename Derived>
+class StringBuilderBase
+{
+public:
+    Derived& append(const QChar* data, int size)
+    {
+        memcpy(derived().appendSpace(size), data, size * sizeof(QChar));
+        return derived();
+    }
+
+    Derived& append(const QString& string)
+    {
+        return append(string.constData(), string.size());
+    }
+
+    Derived& append(QStringView string)
+    {
+        return append(string.data(), string.size());
+    }
+
+    Derived& append(QLatin1String string)
+    {
+        const uchar* src = reinterpret_cast<const uchar*>(string.data());
+        ushort* dst = derived().appendSpace(string.size());
+        for (int i = 0; i < string.size(); ++i) {
+            dst[i] = src[i];
+        }
+        return derived();
+    }
+
+    Derived& append(QChar c)
+    {
+        *derived().appendSpace(1) = c.unicode();
+        return derived();
+    }
+
+    Derived& appendNumber(qlonglong value)
+    {
+        ushort buffer[20];
+        const int length = formatDecimal(value, buffer);
+        memcpy(derived().appendSpace(length), buffer, length * sizeof(ushort));
+        return derived();
+    }
+
+private:
+    Derived& derived()
+    {
+        return static_cast<Derived&>(*this);
+    }
+};
+
+/**
+ * Builds a string in a contiguous buffer, which is stored inline for up to
+ * INLINE_SIZE characters and on the heap with geometric growth beyond that.
+ *
+ * The result can be looked at via view() without creating a QString at all.
+ */
+template<int INLINE_SIZE>
+class InlineStringBuilder : public StringBuilderBase<InlineStringBuilder<INLINE_SIZE>>
+{
+public:
+    InlineStringBuilder() = default;
+    Q_DISABLE_COPY(InlineStringBuilder)
+
+    ushort* appendSpace(int size)
+    {
+        if (Q_UNLIKELY(m_size + size > m_capacity)) {
+            grow(m_size + size);
+        }
+        ushort* space = m_data + m_size;
+        m_size += size;
+        return space;
+    }
+
+    void reserve(int capacity)
+    {
+        if (capacity > m_capacity) {
+            grow(capacity);
+        }
+    }
+
+    int size() const
+    {
+        return m_size;
+    }
+
+    bool isInline() const
+    {
+        return m_data == m_inline;
+    }
+
+    // only valid until the next append
+    QStringView view() const
+    {
+        return QStringView(m_data, m_size);
+    }
+
+    QString toString() const
+    {
+        return QString(reinterpret_cast<const QChar*>(m_data), m_size);
+    }
+
+    // keeps the heap buffer around for the next string
+    void clear()
+    {
+        m_size = 0;
+    }
+
+private:
+    void grow(int size)
+    {
+        int capacity = m_capacity * 2;
+        if (capacity < size) {
+            capacity = size;
+        }
+        std::unique_ptr<ushort[]> heap(new ushort[capacity]);
+        memcpy(heap.get(), m_data, m_size * sizeof(ushort));
+        m_heap = std::move(heap);
+        m_data = m_heap.get();
+        m_capacity = capacity;
+    }
+
+    // intentionally left uninitialized
+    ushort m_inline[INLINE_SIZE];
+    std::unique_ptr<ushort[]> m_heap;
+    ushort* m_data = m_inline;
+    int m_size = 0;
+    int m_capacity = INLINE_SIZE;
+};
+
+/**
+ * Builds a string in a list of arena chunks which are never reallocated,
+ * such that appending never copies what was appended before. The string is
+ * materialized with a single allocation of the exact size by toString().
+ *
+ * A fragment which does not fit into the rest of the current chunk starts a
+ * new one, the chunks double in size to bound the space lost that way.
+ */
+class ArenaStringBuilder : public StringBuilderBase<ArenaStringBuilder>
+{
+public:
+    ArenaStringBuilder() = default;
+    Q_DISABLE_COPY(ArenaStringBuilder)
+
+    ushort* appendSpace(int size)
+    {
+        if (Q_UNLIKELY(m_pos + size > m_end)) {
+            nextChunk(size);
+        }
+        ushort* space = m_pos;
+        m_pos += size;
+        m_size += size;
+        return space;
+    }
+
+    int size() const
+    {
+        return m_size;
+    }
+
+    // the number of chunks in use, 1 means the string is contiguous
+    int chunkCount() const
+    {
+        return m_chunks.empty() ? 0 : static_cast<int>(m_current) + 1;
+    }
+
+    // call @p func with a QStringView for each chunk in use, in order
+    template<typename Func>
+    void forEachChunk(Func func) const
+    {
+        for (size_t i = 0; i < m_chunks.size() && i <= m_current; ++i) {
+            func(QStringView(m_chunks[i].data.get(), usedSize(i)));
+        }
+    }
+
+    QString toString() const
+    {
+        QString result(m_size, Qt::Uninitialized);
+        QChar* out = result.data();
+        forEachChunk([&out](QStringView chunk) {
+            memcpy(out, chunk.data(), chunk.size() * sizeof(QChar));
+            out += chunk.size();
+        });
+        return result;
+    }
+
+    // keeps the chunks around for the next string
+    void clear()
+    {
+        m_current = 0;
+        m_size = 0;
+        if (m_chunks.empty()) {
+            m_pos = m_end = nullptr;
+        } else {
+            setChunk(0);
+        }
+    }
+
+private:
+    static const int FIRST_CHUNK_SIZE = 4096;
+
+    struct Chunk
+    {
+        std::unique_ptr<ushort[]> data;
+        int capacity;
+        int used;
+    };
+
+    int usedSize(size_t index) const
+    {
+        return index == m_current ? static_cast<int>(m_pos - m_chunks[index].data.get()) : m_chunks[index].used;
+    }
+
+    void nextChunk(int size)
+    {
+        if (!m_chunks.empty()) {
+            m_chunks[m_current].used = usedSize(m_current);
+            ++m_current;
+        }
+        // reuse the chunks left over from before the last clear, if they are large enough
+        while (m_current < m_chunks.size() && m_chunks[m_current].capacity < size) {
+            m_chunks.erase(m_chunks.begin() + m_current);
+        }
+        if (m_current == m_chunks.size()) {
+            int capacity = m_chunks.empty() ? FIRST_CHUNK_SIZE : m_chunks.back().capacity * 2;
+            if (capacity < size) {
+                capacity = size;
+            }
+            m_chunks.push_back({std::unique_ptr<ushort[]>(new ushort[capacity]), capacity, 0});
+        }
+        setChunk(m_current);
+    }
+
+    void setChunk(size_t index)
+    {
+        m_pos = m_chunks[index].data.get();
+        m_end = m_pos + m_chunks[index].capacity;
+    }
+
+    std::vector<Chunk> m_chunks;
+    size_t m_current = 0;
+    ushort* m_pos = nullptr;
+    ushort* m_end = nullptr;
+    int m_size = 0;
+};
+
+#endif
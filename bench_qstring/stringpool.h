@@ -0,0 +1,392 @@
+/**
+ *
+ * Copyright (C) 2015 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com, author Milian Wolff <milian.wolff@kdab.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef BENCH_QT_STRINGPOOL_H
+#define BENCH_QT_STRINGPOOL_H
+
+#include <QString>
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * A handle for an interned string, see StringPool.
+ *
+ * Two atoms of the same pool are equal iff their strings are equal, so comparing
+ * and hashing them only touches a single integer.
+ */
+class Atom
+{
+public:
+    Atom() = default;
+
+    explicit Atom(quint32 id)
+        : m_id(id)
+    {
+    }
+
+    bool isValid() const
+    {
+        return m_id != INVALID;
+    }
+
+    quint32 id() const
+    {
+        return m_id;
+    }
+
+    bool operator==(Atom other) const
+    {
+        return m_id == other.m_id;
+    }
+
+    bool operator!=(Atom other) const
+    {
+        return m_id != other.m_id;
+    }
+
+private:
+    static const quint32 INVALID = 0xffffffff;
+    quint32 m_id = INVALID;
+};
+
+inline uint qHash(Atom atom, uint seed = 0)
+{
+    return atom.id() ^ seed;
+}
+
+/**
+ * A thread safe string interning pool.
+ *
+ * Strings are distributed over SHARDS shards by their hash. Each shard is an open
+ * addressing hash table of atomic pointers to immutable entries. Lookups never
+ * lock: they load the current table and probe it with acquire semantics.
+ * Insertions lock only the mutex of their shard, publish the new entry with
+ * release semantics and grow the table by publishing a copy. Tables that got
+ * replaced, and all entries, stay alive until the pool is destroyed, such that
+ * concurrent readers never see freed memory.
+ *
+ * The atom id stores the shard in its low bits and the index of the entry
+ * within the shard in the others. The entries of a shard live in chunks of
+ * doubling size which never move, which makes string() lock free as well.
+ */
+class StringPool
+{
+public:
+    StringPool() = default;
+    StringPool(const StringPool&) = delete;
+    StringPool& operator=(const StringPool&) = delete;
+
+    Atom intern(const QString& string)
+    {
+        return intern(Key(string));
+    }
+
+    Atom intern(QLatin1String string)
+    {
+        return intern(Key(string));
+    }
+
+    // the atom for @p string, or an invalid one if it was never interned
+    Atom find(const QString& string) const
+    {
+        const Key key(string);
+        const Entry* entry = shardFor(key.hash).find(key);
+        return entry ? entry->atom : Atom();
+    }
+
+    Atom find(QLatin1String string) const
+    {
+        const Key key(string);
+        const Entry* entry = shardFor(key.hash).find(key);
+        return entry ? entry->atom : Atom();
+    }
+
+    const QString& string(Atom atom) const
+    {
+        return m_shards[atom.id() & (SHARDS - 1)].entry(atom.id() >> SHARD_BITS)->string;
+    }
+
+    // the number of distinct strings
+    int size() const
+    {
+        int size = 0;
+        for (const Shard& shard : m_shards) {
+            size += shard.size.load(std::memory_order_relaxed);
+        }
+        return size;
+    }
+
+    // an estimate of the bytes used by the pool, including its strings
+    size_t memoryUsage() const
+    {
+        size_t usage = sizeof(*this);
+        for (const Shard& shard : m_shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (const auto& table : shard.tables) {
+                usage += sizeof(Table) + table->capacity * sizeof(std::atomic<const Entry*>);
+            }
+            for (size_t chunk = 0; chunk < shard.chunks.size(); ++chunk) {
+                usage += chunkSize(static_cast<int>(chunk)) * sizeof(Entry);
+            }
+            const int size = shard.size.load(std::memory_order_relaxed);
+            for (int i = 0; i < size; ++i) {
+                usage += stringMemoryUsage(shard.entry(i)->string);
+            }
+        }
+        return usage;
+    }
+
+    // an estimate of the heap memory a non-shared @p string uses
+    static size_t stringMemoryUsage(const QString& string)
+    {
+        // the QArrayData header plus the null terminated UTF-16 data
+        return 3 * sizeof(void*) + (static_cast<size_t>(string.size()) + 1) * sizeof(QChar);
+    }
+
+private:
+    static const int SHARD_BITS = 4;
+    static const int SHARDS = 1 << SHARD_BITS;
+    // chunk i holds FIRST_CHUNK_SIZE << i entries
+    static const int FIRST_CHUNK_SIZE = 16;
+    static const int MAX_CHUNKS = 32 - SHARD_BITS - 4;
+    static const int INITIAL_CAPACITY = 64;
+
+    static int chunkSize(int chunk)
+    {
+        return FIRST_CHUNK_SIZE << chunk;
+    }
+
+    // the chunk containing the entry at @p index and the index within that chunk
+    static int chunkOf(int index, int* offset)
+    {
+        const uint chunk = 31 - __builtin_clz(static_cast<uint>(index) / FIRST_CHUNK_SIZE + 1);
+        *offset = index - FIRST_CHUNK_SIZE * ((1 << chunk) - 1);
+        return static_cast<int>(chunk);
+    }
+
+    // a string to look up, either UTF-16 or Latin-1
+    struct Key
+    {
+        explicit Key(const QString& string)
+            : utf16(reinterpret_cast<const ushort*>(string.constData()))
+            , size(string.size())
+            , qstring(&string)
+        {
+            // FNV-1a, over code units such that QString and QLatin1String hash the same
+            for (int i = 0; i < size; ++i) {
+                hash = (hash ^ utf16[i]) * 16777619u;
+            }
+        }
+
+        explicit Key(QLatin1String string)
+            : latin1(reinterpret_cast<const uchar*>(string.data()))
+            , size(string.size())
+        {
+            for (int i = 0; i < size; ++i) {
+                hash = (hash ^ latin1[i]) * 16777619u;
+            }
+        }
+
+        bool operator==(const QString& string) const
+        {
+            if (string.size() != size) {
+                return false;
+            }
+            // constData, unlike utf16, never detaches
+            const ushort* other = reinterpret_cast<const ushort*>(string.constData());
+            if (utf16) {
+                return memcmp(utf16, other, static_cast<size_t>(size) * sizeof(ushort)) == 0;
+            }
+            for (int i = 0; i < size; ++i) {
+                if (other[i] != latin1[i]) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        QString toString() const
+        {
+            if (qstring) {
+                return *qstring;
+            }
+            return QString::fromLatin1(reinterpret_cast<const char*>(latin1), size);
+        }
+
+        const ushort* utf16 = nullptr;
+        const uchar* latin1 = nullptr;
+        int size;
+        const QString* qstring = nullptr;
+        uint hash = 2166136261u;
+    };
+
+    struct Entry
+    {
+        uint hash;
+        Atom atom;
+        QString string;
+    };
+
+    struct Table
+    {
+        explicit Table(int capacity)
+            : capacity(capacity)
+            , buckets(new std::atomic<const Entry*>[capacity])
+        {
+            for (int i = 0; i < capacity; ++i) {
+                buckets[i].store(nullptr, std::memory_order_relaxed);
+            }
+        }
+
+        const int capacity;
+        std::unique_ptr<std::atomic<const Entry*>[]> buckets;
+    };
+
+    struct Shard
+    {
+        Shard()
+        {
+            tables.emplace_back(new Table(INITIAL_CAPACITY));
+            table.store(tables.back().get(), std::memory_order_relaxed);
+            for (auto& chunk : chunkPointers) {
+                chunk.store(nullptr, std::memory_order_relaxed);
+            }
+        }
+
+        const Entry* find(const Key& key) const
+        {
+            const Table* current = table.load(std::memory_order_acquire);
+            const int mask = current->capacity - 1;
+            for (int i = key.hash & mask;; i = (i + 1) & mask) {
+                const Entry* entry = current->buckets[i].load(std::memory_order_acquire);
+                if (!entry) {
+                    return nullptr;
+                } else if (entry->hash == key.hash && key == entry->string) {
+                    return entry;
+                }
+            }
+        }
+
+        const Entry* entry(int index) const
+        {
+            int offset = 0;
+            const int chunk = chunkOf(index, &offset);
+            return chunkPointers[chunk].load(std::memory_order_acquire) + offset;
+        }
+
+        // must be called with the mutex locked
+        Entry* newEntry(int shardIndex, const Key& key)
+        {
+            const int index = size.load(std::memory_order_relaxed);
+            int offset = 0;
+            const int chunk = chunkOf(index, &offset);
+            if (chunk == static_cast<int>(chunks.size())) {
+                Q_ASSERT(chunk < MAX_CHUNKS);
+                chunks.emplace_back(new Entry[chunkSize(chunk)]);
+                chunkPointers[chunk].store(chunks.back().get(), std::memory_order_release);
+            }
+            Entry* entry = chunks[chunk].get() + offset;
+            entry->hash = key.hash;
+            entry->atom = Atom(static_cast<quint32>(index) << SHARD_BITS | static_cast<quint32>(shardIndex));
+            entry->string = key.toString();
+            size.store(index + 1, std::memory_order_relaxed);
+            return entry;
+        }
+
+        // must be called with the mutex locked
+        void insert(const Entry* entry)
+        {
+            Table* current = tables.back().get();
+            // keep the load factor below 1/2
+            if (2 * (size.load(std::memory_order_relaxed) + 1) > current->capacity) {
+                tables.emplace_back(new Table(current->capacity * 2));
+                Table* grown = tables.back().get();
+                for (int i = 0; i < current->capacity; ++i) {
+                    if (const Entry* existing = current->buckets[i].load(std::memory_order_relaxed)) {
+                        insertInto(grown, existing);
+                    }
+                }
+                table.store(grown, std::memory_order_release);
+                current = grown;
+            }
+            insertInto(current, entry);
+        }
+
+        static void insertInto(Table* table, const Entry* entry)
+        {
+            const int mask = table->capacity - 1;
+            int i = entry->hash & mask;
+            while (table->buckets[i].load(std::memory_order_relaxed)) {
+                i = (i + 1) & mask;
+            }
+            table->buckets[i].store(entry, std::memory_order_release);
+        }
+
+        mutable std::mutex mutex;
+        std::atomic<const Table*> table;
+        std::atomic<int> size{0};
+        std::vector<std::unique_ptr<Table>> tables;
+        std::vector<std::unique_ptr<Entry[]>> chunks;
+        std::atomic<const Entry*> chunkPointers[MAX_CHUNKS];
+    };
+
+    const Shard& shardFor(uint hash) const
+    {
+        return m_shards[hash >> (32 - SHARD_BITS)];
+    }
+
+    Atom intern(const Key& key)
+    {
+        const int shardIndex = static_cast<int>(key.hash >> (32 - SHARD_BITS));
+        Shard& shard = m_shards[shardIndex];
+        if (const Entry* entry = shard.find(key)) {
+            return entry->atom;
+        }
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        // another thread may have inserted it in the meantime
+        if (const Entry* entry = shard.find(key)) {
+            return entry->atom;
+        }
+        const Entry* entry = shard.newEntry(shardIndex, key);
+        shard.insert(entry);
+        return entry->atom;
+    }
+
+    Shard m_shards[SHARDS];
+};
+
+#endif
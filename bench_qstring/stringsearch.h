@@ -0,0 +1,482 @@
+/**
+ *
+ * Copyright (C) 2015 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com, author Milian Wolff <milian.wolff@kdab.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef BENCH_QT_STRINGSEARCH_H
+#define BENCH_QT_STRINGSEARCH_H
+
+#include <QString>
+#include <QStringList>
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <vector>
+
+#if defined(Q_PROCESSOR_X86) && defined(__SSE2__)
+#include <immintrin.h>
+#define HAVE_SEARCH_SIMD
+#endif
+
+/**
+ * Substring search over UTF-16.
+ *
+ * - indexOf: compares the first and last character of the needle at 8 (SSE2)
+ *   or 16 (AVX2) haystack positions at once and only verifies the candidates
+ * - TwoWay: the Crochemore-Perrin algorithm, linear time and constant space
+ * - Horspool: Boyer-Moore-Horspool, with the bad character table indexed by
+ *   the low byte of the UTF-16 code units
+ * - AhoCorasick: finds all occurrences of many patterns in a single pass
+ *
+ * All of them match code units exactly, like Qt::CaseSensitive.
+ */
+namespace StringSearch {
+
+inline bool equal(const ushort* a, const ushort* b, int size)
+{
+    return size <= 0 || memcmp(a, b, static_cast<size_t>(size) * sizeof(ushort)) == 0;
+}
+
+inline int indexOfScalar(const ushort* haystack, int haystackSize, const ushort* needle, int needleSize, int from)
+{
+    const ushort first = needle[0];
+    for (int i = from; i <= haystackSize - needleSize; ++i) {
+        if (haystack[i] == first && equal(haystack + i + 1, needle + 1, needleSize - 1)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+#ifdef HAVE_SEARCH_SIMD
+// verify the candidates in @p mask, which has two bits per position starting at @p offset
+inline int verifyCandidates(uint mask, int offset, const ushort* haystack, const ushort* needle, int needleSize)
+{
+    while (mask) {
+        const int position = offset + __builtin_ctz(mask) / 2;
+        if (equal(haystack + position + 1, needle + 1, needleSize - 2)) {
+            return position;
+        }
+        mask &= mask - 1;
+        mask &= mask - 1;
+    }
+    return -1;
+}
+
+inline int indexOfSse2(const ushort* haystack, int haystackSize, const ushort* needle, int needleSize)
+{
+    const __m128i first = _mm_set1_epi16(static_cast<short>(needle[0]));
+    const __m128i last = _mm_set1_epi16(static_cast<short>(needle[needleSize - 1]));
+    const int end = haystackSize - needleSize + 1;
+    int i = 0;
+    for (; i + 8 <= end; i += 8) {
+        const __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + i));
+        const __m128i blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + i + needleSize - 1));
+        const uint mask = static_cast<uint>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi16(blockFirst, first),
+                                                                            _mm_cmpeq_epi16(blockLast, last))));
+        if (mask) {
+            const int position = verifyCandidates(mask, i, haystack, needle, needleSize);
+            if (position != -1) {
+                return position;
+            }
+        }
+    }
+    return indexOfScalar(haystack, haystackSize, needle, needleSize, i);
+}
+
+__attribute__((target("avx2")))
+inline int indexOfAvx2(const ushort* haystack, int haystackSize, const ushort* needle, int needleSize)
+{
+    const __m256i first = _mm256_set1_epi16(static_cast<short>(needle[0]));
+    const __m256i last = _mm256_set1_epi16(static_cast<short>(needle[needleSize - 1]));
+    const int end = haystackSize - needleSize + 1;
+    int i = 0;
+    for (; i + 16 <= end; i += 16) {
+        const __m256i blockFirst = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + i));
+        const __m256i blockLast = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + i + needleSize - 1));
+        const uint mask = static_cast<uint>(_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi16(blockFirst, first),
+                                                                                  _mm256_cmpeq_epi16(blockLast, last))));
+        if (mask) {
+            const int position = verifyCandidates(mask, i, haystack, needle, needleSize);
+            if (position != -1) {
+                return position;
+            }
+        }
+    }
+    return indexOfScalar(haystack, haystackSize, needle, needleSize, i);
+}
+#endif
+
+/**
+ * @return the position of the first occurrence of @p needle in @p haystack, or -1
+ */
+inline int indexOf(const ushort* haystack, int haystackSize, const ushort* needle, int needleSize)
+{
+    if (!needleSize) {
+        return 0;
+    } else if (needleSize > haystackSize) {
+        return -1;
+    }
+#ifdef HAVE_SEARCH_SIMD
+    static const auto search = __builtin_cpu_supports("avx2") ? indexOfAvx2 : indexOfSse2;
+    return search(haystack, haystackSize, needle, needleSize);
+#else
+    return indexOfScalar(haystack, haystackSize, needle, needleSize, 0);
+#endif
+}
+
+inline int indexOf(const QString& haystack, const QString& needle)
+{
+    return indexOf(haystack.utf16(), haystack.size(), needle.utf16(), needle.size());
+}
+
+class TwoWay
+{
+public:
+    TwoWay(const ushort* needle, int size)
+        : m_needle(needle, needle + size)
+    {
+        int period = 1;
+        int reversedPeriod = 1;
+        const int suffix = maximalSuffix(false, &period);
+        const int reversedSuffix = maximalSuffix(true, &reversedPeriod);
+        if (suffix > reversedSuffix) {
+            m_critical = suffix;
+            m_period = period;
+        } else {
+            m_critical = reversedSuffix;
+            m_period = reversedPeriod;
+        }
+        m_periodic = m_critical + 1 + m_period <= size && equal(needle, needle + m_period, m_critical + 1);
+        if (!m_periodic) {
+            m_period = std::max(m_critical + 1, size - m_critical - 1) + 1;
+        }
+    }
+
+    explicit TwoWay(const QString& needle)
+        : TwoWay(needle.utf16(), needle.size())
+    {
+    }
+
+    int indexIn(const ushort* haystack, int haystackSize) const
+    {
+        const ushort* x = m_needle.data();
+        const int m = static_cast<int>(m_needle.size());
+        if (!m) {
+            return 0;
+        }
+        int j = 0;
+        if (m_periodic) {
+            // the prefix up to the memory is known to match after a shift by the period
+            int memory = -1;
+            while (j <= haystackSize - m) {
+                int i = std::max(m_critical, memory) + 1;
+                while (i < m && x[i] == haystack[i + j]) {
+                    ++i;
+                }
+                if (i >= m) {
+                    i = m_critical;
+                    while (i > memory && x[i] == haystack[i + j]) {
+                        --i;
+                    }
+                    if (i <= memory) {
+                        return j;
+                    }
+                    j += m_period;
+                    memory = m - m_period - 1;
+                } else {
+                    j += i - m_critical;
+                    memory = -1;
+                }
+            }
+        } else {
+            while (j <= haystackSize - m) {
+                int i = m_critical + 1;
+                while (i < m && x[i] == haystack[i + j]) {
+                    ++i;
+                }
+                if (i >= m) {
+                    i = m_critical;
+                    while (i >= 0 && x[i] == haystack[i + j]) {
+                        --i;
+                    }
+                    if (i < 0) {
+                        return j;
+                    }
+                    j += m_period;
+                } else {
+                    j += i - m_critical;
+                }
+            }
+        }
+        return -1;
+    }
+
+    int indexIn(const QString& haystack) const
+    {
+        return indexIn(haystack.utf16(), haystack.size());
+    }
+
+private:
+    // the start of the maximal suffix, minus one, for the regular or reversed order
+    int maximalSuffix(bool reversed, int* period) const
+    {
+        const ushort* x = m_needle.data();
+        const int m = static_cast<int>(m_needle.size());
+        int suffix = -1;
+        int j = 0;
+        int k = 1;
+        int p = 1;
+        while (j + k < m) {
+            const ushort a = x[j + k];
+            const ushort b = x[suffix + k];
+            if (reversed ? a > b : a < b) {
+                j += k;
+                k = 1;
+                p = j - suffix;
+            } else if (a == b) {
+                if (k != p) {
+                    ++k;
+                } else {
+                    j += p;
+                    k = 1;
+                }
+            } else {
+                suffix = j;
+                j = suffix + 1;
+                k = p = 1;
+            }
+        }
+        *period = p;
+        return suffix;
+    }
+
+    std::vector<ushort> m_needle;
+    int m_critical = -1;
+    int m_period = 1;
+    bool m_periodic = false;
+};
+
+class Horspool
+{
+public:
+    Horspool(const ushort* needle, int size)
+        : m_needle(needle, needle + size)
+    {
+        std::fill(std::begin(m_shift), std::end(m_shift), size);
+        // characters sharing the low byte share a slot, the later and thus smaller shift wins
+        for (int i = 0; i < size - 1; ++i) {
+            m_shift[needle[i] & 0xff] = size - 1 - i;
+        }
+    }
+
+    explicit Horspool(const QString& needle)
+        : Horspool(needle.utf16(), needle.size())
+    {
+    }
+
+    int indexIn(const ushort* haystack, int haystackSize) const
+    {
+        const int m = static_cast<int>(m_needle.size());
+        if (!m) {
+            return 0;
+        }
+        const ushort* x = m_needle.data();
+        const ushort last = x[m - 1];
+        for (int j = 0; j <= haystackSize - m;) {
+            const ushort c = haystack[j + m - 1];
+            if (c == last && equal(haystack + j, x, m - 1)) {
+                return j;
+            }
+            j += m_shift[c & 0xff];
+        }
+        return -1;
+    }
+
+    int indexIn(const QString& haystack) const
+    {
+        return indexIn(haystack.utf16(), haystack.size());
+    }
+
+private:
+    std::vector<ushort> m_needle;
+    int m_shift[256];
+};
+
+/**
+ * Multi-pattern search with an Aho-Corasick automaton.
+ *
+ * The transitions of the root are a dense table over all UTF-16 code units,
+ * those of all other nodes are sorted arrays in one flat vector.
+ */
+class AhoCorasick
+{
+public:
+    explicit AhoCorasick(const QStringList& patterns)
+        : m_rootTransitions(0x10000, 0)
+    {
+        // build the trie, with std::map for now and flattened below
+        std::vector<std::map<ushort, int>> children(1);
+        m_nodes.resize(1);
+        for (int p = 0; p < patterns.size(); ++p) {
+            const QString& pattern = patterns.at(p);
+            if (pattern.isEmpty()) {
+                continue;
+            }
+            int node = 0;
+            for (const QChar c : pattern) {
+                auto it = children[node].find(c.unicode());
+                if (it == children[node].end()) {
+                    it = children[node].emplace(c.unicode(), static_cast<int>(m_nodes.size())).first;
+                    m_nodes.emplace_back();
+                    children.emplace_back();
+                }
+                node = it->second;
+            }
+            if (m_nodes[node].pattern == -1) {
+                m_nodes[node].pattern = p;
+                m_nodes[node].length = pattern.size();
+            }
+        }
+
+        for (size_t node = 0; node < m_nodes.size(); ++node) {
+            m_nodes[node].firstEdge = static_cast<int>(m_edges.size());
+            for (const auto& child : children[node]) {
+                m_edges.push_back({child.first, child.second});
+            }
+            m_nodes[node].lastEdge = static_cast<int>(m_edges.size());
+        }
+        for (const auto& child : children[0]) {
+            m_rootTransitions[child.first] = child.second;
+        }
+
+        // breadth first, such that the failure links of the parents are known
+        std::vector<int> queue;
+        queue.reserve(m_nodes.size());
+        for (const auto& child : children[0]) {
+            queue.push_back(child.second);
+        }
+        for (size_t i = 0; i < queue.size(); ++i) {
+            const int node = queue[i];
+            for (const auto& child : children[node]) {
+                int fail = m_nodes[node].fail;
+                int next = 0;
+                while (true) {
+                    next = transition(fail, child.first);
+                    if (next != -1 || !fail) {
+                        break;
+                    }
+                    fail = m_nodes[fail].fail;
+                }
+                Node& target = m_nodes[child.second];
+                target.fail = next == -1 ? 0 : next;
+                const Node& failNode = m_nodes[target.fail];
+                target.output = failNode.pattern != -1 ? target.fail : failNode.output;
+                queue.push_back(child.second);
+            }
+        }
+    }
+
+    /**
+     * Call @p callback(position, pattern) for every occurrence of any of the
+     * patterns in @p haystack, including overlapping ones.
+     */
+    template<typename Callback>
+    void findAll(const ushort* haystack, int haystackSize, Callback callback) const
+    {
+        int state = 0;
+        for (int i = 0; i < haystackSize; ++i) {
+            const ushort c = haystack[i];
+            while (true) {
+                const int next = transition(state, c);
+                if (next != -1) {
+                    state = next;
+                    break;
+                } else if (!state) {
+                    break;
+                }
+                state = m_nodes[state].fail;
+            }
+            for (int node = m_nodes[state].pattern != -1 ? state : m_nodes[state].output; node != -1;
+                 node = m_nodes[node].output) {
+                callback(i - m_nodes[node].length + 1, m_nodes[node].pattern);
+            }
+        }
+    }
+
+    int count(const QString& haystack) const
+    {
+        int matches = 0;
+        findAll(haystack.utf16(), haystack.size(), [&matches](int, int) { ++matches; });
+        return matches;
+    }
+
+private:
+    struct Node
+    {
+        int fail = 0;
+        // the next node along the failure links which ends a pattern
+        int output = -1;
+        // the first pattern ending at this node, and its length
+        int pattern = -1;
+        int length = 0;
+        int firstEdge = 0;
+        int lastEdge = 0;
+    };
+
+    struct Edge
+    {
+        ushort c;
+        int next;
+    };
+
+    // the next node, or -1 when there is no transition for @p c
+    int transition(int node, ushort c) const
+    {
+        if (!node) {
+            const int next = m_rootTransitions[c];
+            return next ? next : -1;
+        }
+        const auto begin = m_edges.begin() + m_nodes[node].firstEdge;
+        const auto end = m_edges.begin() + m_nodes[node].lastEdge;
+        const auto it = std::lower_bound(begin, end, c, [](const Edge& edge, ushort c) { return edge.c < c; });
+        return it != end && it->c == c ? it->next : -1;
+    }
+
+    std::vector<Node> m_nodes;
+    std::vector<Edge> m_edges;
+    std::vector<int> m_rootTransitions;
+};
+
+}
+
+#endif
@@ -0,0 +1,274 @@
+/**
+ *
+ * Copyright (C) 2015 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com, author Milian Wolff <milian.wolff@kdab.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef BENCH_QT_UTF8SIMD_H
+#define BENCH_QT_UTF8SIMD_H
+
+#include <QChar>
+#include <QtGlobal>
+
+#if defined(Q_PROCESSOR_X86) && defined(__SSE2__)
+#include <immintrin.h>
+#define HAVE_UTF8_SIMD
+#endif
+
+/**
+ * A vectorized UTF-16 to UTF-8 converter.
+ *
+ * The input is processed in blocks of 8 (SSE2) or 16 (AVX2) code units.
+ * Blocks consisting only of ASCII are narrowed directly, blocks consisting only
+ * of two byte sequences, and with AVX2 three byte sequences, are encoded
+ * without any branches per code unit. Other blocks, i.e. mixed ones or those
+ * containing surrogates, have their leading ASCII run narrowed in one go and
+ * the next code point encoded by the scalar code, which correctly pairs
+ * surrogates across block boundaries.
+ *
+ * Like in ConvertQStringToUtf8_QUtf8Functions, unpaired surrogates are replaced
+ * by '?'. When the output buffer is too small, the conversion stops before the
+ * first code point that does not fit completely.
+ */
+namespace Utf8Simd {
+
+// encode [src, stop) as UTF-8, returns false when the output is full
+inline bool convertScalar(const ushort*& src, const ushort* end, const ushort* stop, uchar*& dst, uchar* dstEnd)
+{
+    while (src < stop) {
+        const uint uc = *src;
+        if (uc < 0x80) {
+            if (dst == dstEnd) {
+                return false;
+            }
+            *dst++ = static_cast<uchar>(uc);
+            ++src;
+        } else if (uc < 0x800) {
+            if (dstEnd - dst < 2) {
+                return false;
+            }
+            *dst++ = static_cast<uchar>(0xc0 | (uc >> 6));
+            *dst++ = static_cast<uchar>(0x80 | (uc & 0x3f));
+            ++src;
+        } else if (!QChar::isSurrogate(uc)) {
+            if (dstEnd - dst < 3) {
+                return false;
+            }
+            *dst++ = static_cast<uchar>(0xe0 | (uc >> 12));
+            *dst++ = static_cast<uchar>(0x80 | ((uc >> 6) & 0x3f));
+            *dst++ = static_cast<uchar>(0x80 | (uc & 0x3f));
+            ++src;
+        } else if (QChar::isHighSurrogate(uc) && end - src >= 2 && QChar::isLowSurrogate(src[1])) {
+            if (dstEnd - dst < 4) {
+                return false;
+            }
+            const uint ucs4 = QChar::surrogateToUcs4(static_cast<ushort>(uc), src[1]);
+            *dst++ = static_cast<uchar>(0xf0 | (ucs4 >> 18));
+            *dst++ = static_cast<uchar>(0x80 | ((ucs4 >> 12) & 0x3f));
+            *dst++ = static_cast<uchar>(0x80 | ((ucs4 >> 6) & 0x3f));
+            *dst++ = static_cast<uchar>(0x80 | (ucs4 & 0x3f));
+            src += 2;
+        } else {
+            // unpaired surrogate
+            if (dst == dstEnd) {
+                return false;
+            }
+            *dst++ = '?';
+            ++src;
+        }
+    }
+    return true;
+}
+
+#ifdef HAVE_UTF8_SIMD
+inline bool convertSse2(const ushort*& src, const ushort* end, uchar*& dst, uchar* dstEnd)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i asciiMask = _mm_set1_epi16(static_cast<short>(0xff80));
+    const __m128i twoByteMask = _mm_set1_epi16(static_cast<short>(0xf800));
+    const __m128i lowBits = _mm_set1_epi16(0x3f);
+    const __m128i continuation = _mm_set1_epi16(0x80);
+    const __m128i twoByteLead = _mm_set1_epi16(0xc0);
+
+    // up to 16 bytes are written per iteration
+    while (end - src >= 8 && dstEnd - dst >= 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        const int ascii = _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(chunk, asciiMask), zero));
+        if (ascii == 0xffff) {
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), _mm_packus_epi16(chunk, chunk));
+            src += 8;
+            dst += 8;
+            continue;
+        }
+        const int twoByte = _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(chunk, twoByteMask), zero));
+        if (!ascii && twoByte == 0xffff) {
+            const __m128i lead = _mm_or_si128(_mm_srli_epi16(chunk, 6), twoByteLead);
+            const __m128i trail = _mm_or_si128(_mm_and_si128(chunk, lowBits), continuation);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_or_si128(lead, _mm_slli_epi16(trail, 8)));
+            src += 8;
+            dst += 16;
+            continue;
+        }
+        // narrow the leading ASCII run, the garbage behind it gets overwritten later on
+        const int asciiRun = __builtin_ctz(~ascii) / 2;
+        if (asciiRun) {
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), _mm_packus_epi16(chunk, chunk));
+            src += asciiRun;
+            dst += asciiRun;
+            continue;
+        }
+        if (!convertScalar(src, end, src + 1, dst, dstEnd)) {
+            return false;
+        }
+    }
+    return convertScalar(src, end, end, dst, dstEnd);
+}
+
+__attribute__((target("avx2")))
+inline bool convertAvx2(const ushort*& src, const ushort* end, uchar*& dst, uchar* dstEnd)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i asciiMask = _mm256_set1_epi16(static_cast<short>(0xff80));
+    const __m256i twoByteMask = _mm256_set1_epi16(static_cast<short>(0xf800));
+    const __m256i surrogate = _mm256_set1_epi16(static_cast<short>(0xd800));
+    const __m256i lowBits = _mm256_set1_epi16(0x3f);
+    const __m256i continuation = _mm256_set1_epi16(0x80);
+    const __m256i twoByteLead = _mm256_set1_epi16(0xc0);
+    const __m256i threeByteLead = _mm256_set1_epi16(0xe0);
+    // interleave the lead and middle bytes with the trailing bytes into 3 byte sequences,
+    // separately for the 8 code units in each 128 bit lane
+    const __m256i firstLeadMiddle = _mm256_broadcastsi128_si256(
+        _mm_setr_epi8(0, 1, -1, 2, 3, -1, 4, 5, -1, 6, 7, -1, 8, 9, -1, 10));
+    const __m256i firstTrail = _mm256_broadcastsi128_si256(
+        _mm_setr_epi8(-1, -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1));
+    const __m256i secondLeadMiddle = _mm256_broadcastsi128_si256(
+        _mm_setr_epi8(11, -1, 12, 13, -1, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1));
+    const __m256i secondTrail = _mm256_broadcastsi128_si256(
+        _mm_setr_epi8(-1, 5, -1, -1, 6, -1, -1, 7, -1, -1, -1, -1, -1, -1, -1, -1));
+
+    // up to 48 bytes are written per iteration
+    while (end - src >= 16 && dstEnd - dst >= 48) {
+        const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+        const uint ascii = static_cast<uint>(_mm256_movemask_epi8(_mm256_cmpeq_epi16(_mm256_and_si256(chunk, asciiMask), zero)));
+        // packus narrows within each 128 bit lane, so gather the low quadwords of both lanes
+        const __m256i narrowed = _mm256_permute4x64_epi64(_mm256_packus_epi16(chunk, chunk), 0x08);
+        if (ascii == 0xffffffff) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm256_castsi256_si128(narrowed));
+            src += 16;
+            dst += 16;
+            continue;
+        }
+        const __m256i highBits = _mm256_and_si256(chunk, twoByteMask);
+        const uint twoByte = static_cast<uint>(_mm256_movemask_epi8(_mm256_cmpeq_epi16(highBits, zero)));
+        if (!ascii && twoByte == 0xffffffff) {
+            const __m256i lead = _mm256_or_si256(_mm256_srli_epi16(chunk, 6), twoByteLead);
+            const __m256i trail = _mm256_or_si256(_mm256_and_si256(chunk, lowBits), continuation);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), _mm256_or_si256(lead, _mm256_slli_epi16(trail, 8)));
+            src += 16;
+            dst += 32;
+            continue;
+        }
+        const uint surrogates = static_cast<uint>(_mm256_movemask_epi8(_mm256_cmpeq_epi16(highBits, surrogate)));
+        if (!twoByte && !surrogates) {
+            const __m256i lead = _mm256_or_si256(_mm256_srli_epi16(chunk, 12), threeByteLead);
+            const __m256i middle = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi16(chunk, 6), lowBits), continuation);
+            const __m256i trail = _mm256_or_si256(_mm256_and_si256(chunk, lowBits), continuation);
+            const __m256i leadMiddle = _mm256_or_si256(lead, _mm256_slli_epi16(middle, 8));
+            const __m256i trails = _mm256_packus_epi16(trail, trail);
+            const __m256i first = _mm256_or_si256(_mm256_shuffle_epi8(leadMiddle, firstLeadMiddle),
+                                                  _mm256_shuffle_epi8(trails, firstTrail));
+            const __m256i second = _mm256_or_si256(_mm256_shuffle_epi8(leadMiddle, secondLeadMiddle),
+                                                   _mm256_shuffle_epi8(trails, secondTrail));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm256_castsi256_si128(first));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + 16), _mm256_castsi256_si128(second));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 24), _mm256_extracti128_si256(first, 1));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + 40), _mm256_extracti128_si256(second, 1));
+            src += 16;
+            dst += 48;
+            continue;
+        }
+        // narrow the leading ASCII run, the garbage behind it gets overwritten later on
+        const int asciiRun = __builtin_ctz(~ascii) / 2;
+        if (asciiRun) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm256_castsi256_si128(narrowed));
+            src += asciiRun;
+            dst += asciiRun;
+            continue;
+        }
+        if (!convertScalar(src, end, src + 1, dst, dstEnd)) {
+            return false;
+        }
+    }
+    return convertSse2(src, end, dst, dstEnd);
+}
+#endif
+
+typedef bool (*Converter)(const ushort*& src, const ushort* end, uchar*& dst, uchar* dstEnd);
+
+inline bool convertPlain(const ushort*& src, const ushort* end, uchar*& dst, uchar* dstEnd)
+{
+    return convertScalar(src, end, end, dst, dstEnd);
+}
+
+// the best converter for the CPU we are running on
+inline Converter converter()
+{
+#ifdef HAVE_UTF8_SIMD
+    static const Converter converter = __builtin_cpu_supports("avx2") ? convertAvx2 : convertSse2;
+    return converter;
+#else
+    return convertPlain;
+#endif
+}
+
+inline const char* converterName()
+{
+#ifdef HAVE_UTF8_SIMD
+    return converter() == convertAvx2 ? "avx2" : "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+/**
+ * Convert @p size UTF-16 code units at @p src to UTF-8 into @p buffer of @p bufferSize bytes.
+ *
+ * @return the number of bytes written, the output is not null terminated
+ */
+inline int convert(const ushort* src, int size, char* buffer, int bufferSize)
+{
+    uchar* dst = reinterpret_cast<uchar*>(buffer);
+    converter()(src, src + size, dst, dst + bufferSize);
+    return static_cast<int>(dst - reinterpret_cast<uchar*>(buffer));
+}
+
+}
+
+#endif
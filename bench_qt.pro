@@ -1,7 +1,9 @@
 TEMPLATE = subdirs
 SUBDIRS = bench_alloc \
+          bench_compare \
           bench_containers \
           bench_qdatetime \
           bench_qdir \
           bench_qmutex \
           bench_qstring \
+          bench_split \
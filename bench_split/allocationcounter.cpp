@@ -0,0 +1,160 @@
+/**
+ *
+ * Copyright (C) 2015 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com, author Milian Wolff <milian.wolff@kdab.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "allocationcounter.h"
+
+#include <cerrno>
+#include <cstddef>
+
+#ifdef __GLIBC__
+namespace {
+thread_local bool t_counting = false;
+thread_local quint64 t_allocations = 0;
+
+inline void countAllocation()
+{
+    if (t_counting) {
+        ++t_allocations;
+    }
+}
+}
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void* __libc_valloc(size_t size);
+void* __libc_pvalloc(size_t size);
+
+// these take precedence over the ones in glibc for the whole process, including Qt
+void* malloc(size_t size) noexcept
+{
+    countAllocation();
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) noexcept
+{
+    countAllocation();
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) noexcept
+{
+    countAllocation();
+    return __libc_realloc(ptr, size);
+}
+
+// the aligned allocations, e.g. of operator new for over-aligned types
+void* memalign(size_t alignment, size_t size) noexcept
+{
+    countAllocation();
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) noexcept
+{
+    countAllocation();
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size) noexcept
+{
+    if (alignment % sizeof(void*) || (alignment & (alignment - 1))) {
+        return EINVAL;
+    }
+    countAllocation();
+    void* result = __libc_memalign(alignment, size);
+    if (!result) {
+        return ENOMEM;
+    }
+    *ptr = result;
+    return 0;
+}
+
+void* valloc(size_t size) noexcept
+{
+    countAllocation();
+    return __libc_valloc(size);
+}
+
+void* pvalloc(size_t size) noexcept
+{
+    countAllocation();
+    return __libc_pvalloc(size);
+}
+}
+
+bool AllocationCounter::isAvailable()
+{
+    return true;
+}
+
+AllocationCounter::Scope::Scope()
+    : m_start(t_allocations)
+    , m_wasCounting(t_counting)
+{
+    t_counting = true;
+}
+
+AllocationCounter::Scope::~Scope()
+{
+    t_counting = m_wasCounting;
+}
+
+quint64 AllocationCounter::Scope::allocations() const
+{
+    return t_allocations - m_start;
+}
+#else
+bool AllocationCounter::isAvailable()
+{
+    return false;
+}
+
+AllocationCounter::Scope::Scope()
+    : m_start(0)
+    , m_wasCounting(false)
+{
+}
+
+AllocationCounter::Scope::~Scope()
+{
+}
+
+quint64 AllocationCounter::Scope::allocations() const
+{
+    return 0;
+}
+#endif
@@ -0,0 +1,74 @@
+/**
+ *
+ * Copyright (C) 2015 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com, author Milian Wolff <milian.wolff@kdab.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef BENCH_QT_ALLOCATIONCOUNTER_H
+#define BENCH_QT_ALLOCATIONCOUNTER_H
+
+#include <QtGlobal>
+
+/**
+ * Counts the calls to malloc and its siblings on the current thread, which
+ * covers operator new and the allocations of QString and the Qt containers.
+ *
+ * This works by replacing malloc in the executable, see allocationcounter.cpp,
+ * so it lives in its own benchmark binary: that always allocates with glibc,
+ * even if another allocator is preloaded. It is only available with glibc,
+ * and clashes with the sanitizers which replace malloc themselves.
+ */
+namespace AllocationCounter {
+
+bool isAvailable();
+
+/**
+ * Counts the allocations of the current thread during its lifetime, nothing
+ * is counted outside of a scope.
+ */
+class Scope
+{
+public:
+    Scope();
+    ~Scope();
+
+    // the number of allocations so far
+    quint64 allocations() const;
+
+private:
+    Q_DISABLE_COPY(Scope)
+
+    quint64 m_start;
+    bool m_wasCounting;
+};
+
+}
+
+#endif
@@ -0,0 +1,275 @@
+/**
+ *
+ * Copyright (C) 2015 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com, author Milian Wolff <milian.wolff@kdab.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <QtTest>
+#include <QObject>
+#include <QString>
+#include <QStringView>
+#include <QVector>
+#include "../util.h"
+#include "../report.h"
+#include "../stats.h"
+
+#include <algorithm>
+
+#include "stringsplit.h"
+#include "allocationcounter.h"
+
+namespace {
+// the words of the log lines
+const char* const LOG_WORDS[] = {
+  "the", "connection", "to", "server", "was", "established", "request", "failed", "with",
+  "status", "user", "login", "timeout", "after", "retry", "received", "bytes", "from",
+  "client", "debug", "info", "warning", "cache", "miss", "hit", "for", "key", "value"
+};
+const int NUM_LOG_WORDS = sizeof(LOG_WORDS) / sizeof(LOG_WORDS[0]);
+
+/**
+ * Deterministic text of @p bytes bytes of UTF-16 for the split benchmarks,
+ * "csv" are comma separated records and "log" are log lines.
+ *
+ * The last text is cached, as the larger ones take a while to generate.
+ */
+const QString& makeSplitText(const QByteArray& format, int bytes)
+{
+  static QString text;
+  static QByteArray cachedFormat;
+  static int cachedBytes = -1;
+  if (format == cachedFormat && bytes == cachedBytes) {
+    return text;
+  }
+  const int size = bytes / 2;
+  text.clear();
+  text.reserve(size + 256);
+  quint32 random = 42;
+  auto next = [&random]() {
+    // xorshift32
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+    return random;
+  };
+  for (int line = 0; text.size() < size; ++line) {
+    if (format == "csv") {
+      text += QString::number(line) + QLatin1Char(',') + QLatin1String(LOG_WORDS[next() % NUM_LOG_WORDS])
+              + QLatin1Char(',') + QString::number(next() % 100000) + QLatin1Char(',')
+              + QLatin1String(LOG_WORDS[next() % NUM_LOG_WORDS]) + QLatin1Char(' ')
+              + QLatin1String(LOG_WORDS[next() % NUM_LOG_WORDS]) + QLatin1Char(',')
+              + QLatin1String(next() % 2 ? "true" : "false");
+    } else {
+      text += QStringLiteral("2024-05-17 12:%1:%2 ").arg(line / 60 % 60, 2, 10, QLatin1Char('0'))
+                                                     .arg(line % 60, 2, 10, QLatin1Char('0'));
+      text += QLatin1String(next() % 8 ? "INFO" : "WARN");
+      for (int words = 5 + next() % 8; words > 0; --words) {
+        text += QLatin1Char(' ') + QLatin1String(LOG_WORDS[next() % NUM_LOG_WORDS]);
+      }
+    }
+    text += QLatin1Char('\n');
+  }
+  text.truncate(size - 1);
+  text += QLatin1Char('\n');
+  cachedFormat = format;
+  cachedBytes = bytes;
+  return text;
+}
+
+// what the split benchmarks found, to verify that they all see the same tokens
+struct SplitCount
+{
+  qint64 tokens = 0;
+  qint64 length = 0;
+};
+
+// all parts at once like QStringView::split of Qt 6, which Qt 5 lacks, the parts are not copied
+QVector<QStringView> splitView(QStringView string, QChar separator)
+{
+  QVector<QStringView> parts;
+  const QChar* begin = string.data();
+  const QChar* const end = begin + string.size();
+  while (true) {
+    const QChar* next = std::find(begin, end, separator);
+    parts.append(QStringView(begin, next - begin));
+    if (next == end) {
+      return parts;
+    }
+    begin = next + 1;
+  }
+}
+
+/**
+ * Split the text of the current benchmark row into lines and these into
+ * fields with @p split, and report the throughput.
+ *
+ * The allocations per token are counted in an additional, untimed run.
+ */
+template<typename Split>
+void benchSplit(Split split)
+{
+  QFETCH(QByteArray, format);
+  QFETCH(int, bytes);
+  const QString& text = makeSplitText(format, bytes);
+  const QChar separator = QLatin1Char(format == "csv" ? ',' : ' ');
+
+  quint64 allocations = 0;
+  SplitCount count;
+  {
+    const AllocationCounter::Scope scope;
+    count = split(text, separator);
+    allocations = scope.allocations();
+  }
+  // with empty parts kept, every separator and line break adds a token
+  const qint64 separators = text.count(separator) + text.count(QLatin1Char('\n'));
+  QCOMPARE(count.tokens, separators + 1);
+  QCOMPARE(count.length, text.size() - separators);
+  if (AllocationCounter::isAvailable()) {
+    qDebug("%.3f allocations per token, %lld tokens", static_cast<double>(allocations) / count.tokens,
+           count.tokens);
+  }
+
+  BenchStats::reportThroughput(BenchStats::measure(text.size() * static_cast<qint64>(sizeof(QChar)), [&] {
+    SplitCount count = split(text, separator);
+    escape(&count);
+  }));
+}
+}
+
+class BenchSplit : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init()
+    {
+        BenchReport::startPerfCounters();
+    }
+
+    void cleanup()
+    {
+        BenchReport::stopPerfCounters();
+    }
+
+    Q_NEVER_INLINE void benchSplit_data()
+    {
+        QTest::addColumn<QByteArray>("format");
+        QTest::addColumn<int>("bytes");
+        const QPair<const char*, int> sizes[] = {
+            {"1K", 1024}, {"64K", 64 * 1024}, {"1M", 1024 * 1024}, {"100M", 100 * 1024 * 1024}
+        };
+        for (const char* format : {"csv", "log"}) {
+            for (const auto& size : sizes) {
+                QTest::newRow(qPrintable(QStringLiteral("%1/%2").arg(QLatin1String(format)).arg(QLatin1String(size.first))))
+                    << QByteArray(format) << size.second;
+            }
+        }
+    }
+
+    Q_NEVER_INLINE void benchSplitQString_data()
+    {
+        benchSplit_data();
+    }
+
+    Q_NEVER_INLINE void benchSplitQString()
+    {
+        benchSplit([](const QString& text, QChar separator) {
+            SplitCount count;
+            for (const QString& line : text.split(QLatin1Char('\n'))) {
+                for (const QString& field : line.split(separator)) {
+                    ++count.tokens;
+                    count.length += field.size();
+                }
+            }
+            return count;
+        });
+    }
+
+    Q_NEVER_INLINE void benchSplitRef_data()
+    {
+        benchSplit_data();
+    }
+
+    Q_NEVER_INLINE void benchSplitRef()
+    {
+        benchSplit([](const QString& text, QChar separator) {
+            SplitCount count;
+            for (const QStringRef& line : text.splitRef(QLatin1Char('\n'))) {
+                for (const QStringRef& field : line.split(separator)) {
+                    ++count.tokens;
+                    count.length += field.size();
+                }
+            }
+            return count;
+        });
+    }
+
+    Q_NEVER_INLINE void benchSplitStringView_data()
+    {
+        benchSplit_data();
+    }
+
+    Q_NEVER_INLINE void benchSplitStringView()
+    {
+        benchSplit([](const QString& text, QChar separator) {
+            SplitCount count;
+            for (QStringView line : splitView(text, QLatin1Char('\n'))) {
+                for (QStringView field : splitView(line, separator)) {
+                    ++count.tokens;
+                    count.length += field.size();
+                }
+            }
+            return count;
+        });
+    }
+
+    Q_NEVER_INLINE void benchSplitRange_data()
+    {
+        benchSplit_data();
+    }
+
+    Q_NEVER_INLINE void benchSplitRange()
+    {
+        benchSplit([](const QString& text, QChar separator) {
+            SplitCount count;
+            for (QStringView line : SplitRange(text, QLatin1Char('\n'))) {
+                for (QStringView field : SplitRange(line, separator)) {
+                    ++count.tokens;
+                    count.length += field.size();
+                }
+            }
+            return count;
+        });
+    }
+};
+
+BENCH_QT_GUILESS_MAIN(BenchSplit)
+
+#include "bench_split.moc"
@@ -0,0 +1,14 @@
+TEMPLATE = app
+
+QT += testlib
+CONFIG += c++1z testcase release
+
+linux|mac {
+    QMAKE_CXXFLAGS += -g
+}
+
+HEADERS = stringsplit.h \
+          allocationcounter.h
+
+SOURCES = bench_split.cpp \
+          allocationcounter.cpp
@@ -0,0 +1,169 @@
+/**
+ *
+ * Copyright (C) 2015 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com, author Milian Wolff <milian.wolff@kdab.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef BENCH_QT_STRINGSPLIT_H
+#define BENCH_QT_STRINGSPLIT_H
+
+#include <QString>
+#include <QStringView>
+
+#include <iterator>
+
+#if defined(Q_PROCESSOR_X86) && defined(__SSE2__)
+#include <immintrin.h>
+#define HAVE_SPLIT_SIMD
+#endif
+
+/**
+ * @return a pointer to the first @p c in [@p begin, @p end), or @p end
+ */
+inline const ushort* findChar(const ushort* begin, const ushort* end, ushort c)
+{
+#ifdef HAVE_SPLIT_SIMD
+    const __m128i needle = _mm_set1_epi16(static_cast<short>(c));
+    for (; end - begin >= 8; begin += 8) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+        const uint mask = static_cast<uint>(_mm_movemask_epi8(_mm_cmpeq_epi16(block, needle)));
+        if (mask) {
+            return begin + __builtin_ctz(mask) / 2;
+        }
+    }
+#endif
+    for (; begin != end; ++begin) {
+        if (*begin == c) {
+            return begin;
+        }
+    }
+    return end;
+}
+
+/**
+ * Splits a string at a separator lazily, without allocating anything:
+ *
+ *     for (QStringView field : SplitRange(line, QLatin1Char(','))) { ... }
+ *
+ * Like QString::split with QString::KeepEmptyParts, empty tokens are kept
+ * and an empty string yields a single empty token. The string has to outlive
+ * the range and its iterators.
+ */
+class SplitRange
+{
+public:
+    class iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = QStringView;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const QStringView*;
+        using reference = QStringView;
+
+        iterator() = default;
+
+        QStringView operator*() const
+        {
+            return QStringView(m_token, m_tokenEnd - m_token);
+        }
+
+        iterator& operator++()
+        {
+            if (m_tokenEnd == m_end) {
+                m_token = m_tokenEnd = nullptr;
+            } else {
+                m_token = m_tokenEnd + 1;
+                m_tokenEnd = findChar(m_token, m_end, m_separator);
+            }
+            return *this;
+        }
+
+        iterator operator++(int)
+        {
+            iterator old = *this;
+            ++*this;
+            return old;
+        }
+
+        bool operator==(const iterator& other) const
+        {
+            return m_token == other.m_token;
+        }
+
+        bool operator!=(const iterator& other) const
+        {
+            return m_token != other.m_token;
+        }
+
+    private:
+        friend class SplitRange;
+
+        iterator(const ushort* begin, const ushort* end, ushort separator)
+            : m_token(begin)
+            , m_tokenEnd(findChar(begin, end, separator))
+            , m_end(end)
+            , m_separator(separator)
+        {
+        }
+
+        // nullptr for the end iterator
+        const ushort* m_token = nullptr;
+        const ushort* m_tokenEnd = nullptr;
+        const ushort* m_end = nullptr;
+        ushort m_separator = 0;
+    };
+
+    SplitRange(QStringView string, QChar separator)
+        : m_begin(reinterpret_cast<const ushort*>(string.data()))
+        , m_end(m_begin + string.size())
+        , m_separator(separator.unicode())
+    {
+    }
+
+    iterator begin() const
+    {
+        // an empty string has no data, but still yields an empty token
+        static const ushort EMPTY = 0;
+        return m_begin ? iterator(m_begin, m_end, m_separator) : iterator(&EMPTY, &EMPTY, m_separator);
+    }
+
+    iterator end() const
+    {
+        return iterator();
+    }
+
+private:
+    const ushort* m_begin;
+    const ushort* m_end;
+    ushort m_separator;
+};
+
+#endif
@@ -0,0 +1,402 @@
+/**
+ *
+ * Copyright (C) 2015 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com, author Milian Wolff <milian.wolff@kdab.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef BENCH_QT_REPORT_H
+#define BENCH_QT_REPORT_H
+
+#include <QtTest>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSysInfo>
+#include <QTemporaryFile>
+#include <QTextStream>
+#include <QXmlStreamReader>
+
+#ifdef QT_WIDGETS_LIB
+#include <QApplication>
+#endif
+
+#ifdef Q_OS_MAC
+#include <sys/sysctl.h>
+#endif
+
+#include <memory>
+#include <thread>
+
+#include "stats.h"
+#include "util.h"
+
+/**
+ * Machine readable export of the benchmark results.
+ *
+ * When the BENCH_QT_REPORT_DIR environment variable is set, the results of
+ * every benchmark are written to <testcase>.json and <testcase>.csv in that
+ * directory, next to the usual QTestLib output. Both contain information about
+ * the host, compiler, Qt version and CPU, such that results of different runs
+ * can be compared with the bench_compare tool. Results measured with
+ * BenchStats::measure additionally contain the individual samples and their
+ * statistics, see stats.h, and benchmarks which call startPerfCounters() and
+ * stopPerfCounters() their hardware performance counters per iteration.
+ *
+ * Use BENCH_QT_MAIN or BENCH_QT_GUILESS_MAIN instead of the QTestLib
+ * equivalents to enable this.
+ */
+namespace BenchReport {
+
+struct Result
+{
+    QString function;
+    QString tag;
+    QString metric;
+    double value;
+    int iterations;
+};
+
+inline QString compiler()
+{
+#if defined(__clang__)
+    return QStringLiteral("clang " __clang_version__);
+#elif defined(__GNUC__)
+    return QStringLiteral("gcc " __VERSION__);
+#elif defined(_MSC_FULL_VER)
+    return QStringLiteral("msvc ") + QString::number(_MSC_FULL_VER);
+#else
+    return QStringLiteral("unknown");
+#endif
+}
+
+inline QString cpuModel()
+{
+#if defined(Q_OS_LINUX)
+    QFile cpuinfo(QStringLiteral("/proc/cpuinfo"));
+    if (cpuinfo.open(QIODevice::ReadOnly)) {
+        foreach (const QByteArray& line, cpuinfo.readAll().split('\n')) {
+            if (line.startsWith("model name")) {
+                return QString::fromLatin1(line.mid(line.indexOf(':') + 1).trimmed());
+            }
+        }
+    }
+#elif defined(Q_OS_MAC)
+    char brand[256] = {0};
+    size_t size = sizeof(brand) - 1;
+    if (sysctlbyname("machdep.cpu.brand_string", brand, &size, nullptr, 0) == 0) {
+        return QString::fromLatin1(brand);
+    }
+#endif
+    return QSysInfo::currentCpuArchitecture();
+}
+
+inline QJsonObject metadata()
+{
+    QJsonObject metadata;
+    metadata[QStringLiteral("host")] = QSysInfo::machineHostName();
+    metadata[QStringLiteral("os")] = QSysInfo::prettyProductName();
+    metadata[QStringLiteral("kernel")] = QSysInfo::kernelType() + QLatin1Char(' ') + QSysInfo::kernelVersion();
+    metadata[QStringLiteral("cpu")] = cpuModel();
+    metadata[QStringLiteral("architecture")] = QSysInfo::currentCpuArchitecture();
+    metadata[QStringLiteral("hardwareThreads")] = static_cast<int>(std::thread::hardware_concurrency());
+    metadata[QStringLiteral("compiler")] = compiler();
+    metadata[QStringLiteral("qtVersion")] = QString::fromLatin1(qVersion());
+    metadata[QStringLiteral("qtBuildVersion")] = QStringLiteral(QT_VERSION_STR);
+    metadata[QStringLiteral("timestamp")] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    return metadata;
+}
+
+// parse the BenchmarkResult elements out of a QTestLib XML log
+inline QVector<Result> parseXml(QIODevice* device)
+{
+    QVector<Result> results;
+    QXmlStreamReader reader(device);
+    QString function;
+    while (!reader.atEnd()) {
+        if (reader.readNext() != QXmlStreamReader::StartElement) {
+            continue;
+        }
+        const auto attributes = reader.attributes();
+        if (reader.name() == QLatin1String("TestFunction")) {
+            function = attributes.value(QLatin1String("name")).toString();
+        } else if (reader.name() == QLatin1String("BenchmarkResult")) {
+            results.append({function,
+                            attributes.value(QLatin1String("tag")).toString(),
+                            attributes.value(QLatin1String("metric")).toString(),
+                            attributes.value(QLatin1String("value")).toDouble(),
+                            attributes.value(QLatin1String("iterations")).toInt()});
+        }
+    }
+    if (reader.hasError()) {
+        qWarning("failed to parse benchmark results: %s", qPrintable(reader.errorString()));
+    }
+    return results;
+}
+
+inline bool perfCountersEnabled()
+{
+    static const bool enabled = qgetenv("BENCH_QT_PERF_COUNTERS") != "0";
+    return enabled;
+}
+
+inline std::unique_ptr<PerfCounters>& currentPerfCounters()
+{
+    static std::unique_ptr<PerfCounters> counters;
+    return counters;
+}
+
+// the hardware counters of every benchmark, by test function and data tag
+inline QHash<QString, QJsonObject>& perfCounterResults()
+{
+    static QHash<QString, QJsonObject> results;
+    return results;
+}
+
+/**
+ * Prepare counting hardware events for the current benchmark.
+ *
+ * Call this from the init() slot of a benchmark and stopPerfCounters() from
+ * its cleanup() slot, to attach the counters of every benchmark to its output.
+ * Only the measured body is counted, i.e. the QBENCHMARK blocks, the timed
+ * samples of BenchStats::measure and runThreads(), see PerfCounterScope. The
+ * counts are reported per iteration of the body, benchmarks without any are
+ * not reported. Set BENCH_QT_PERF_COUNTERS=0 to disable this.
+ */
+inline void startPerfCounters()
+{
+    if (perfCountersEnabled()) {
+        currentPerfCounters().reset(new PerfCounters);
+        PerfCounters::active() = currentPerfCounters().get();
+    }
+}
+
+inline void stopPerfCounters()
+{
+    PerfCounters::active() = nullptr;
+    std::unique_ptr<PerfCounters> counters = std::move(currentPerfCounters());
+    if (!counters || !counters->iterations()) {
+        return;
+    }
+    counters->stop();
+    if (!counters->isAvailable()) {
+        static bool warned = false;
+        if (!warned) {
+            warned = true;
+            qDebug("hardware performance counters unavailable: %s", qPrintable(counters->error()));
+        }
+        return;
+    }
+
+    qDebug("%s per iteration, %lld iterations", qPrintable(counters->summary()), counters->iterations());
+    QJsonObject result;
+    for (int i = 0; i < PerfCounters::NUM_EVENTS; ++i) {
+        const auto event = static_cast<PerfCounters::Event>(i);
+        if (counters->isAvailable(event)) {
+            result[QLatin1String(PerfCounters::eventName(event))] = counters->perIteration(event);
+        }
+    }
+    result[QStringLiteral("iterations")] = static_cast<double>(counters->iterations());
+    perfCounterResults()[BenchStats::summaryKey(QString::fromLatin1(QTest::currentTestFunction()),
+                                                QString::fromLatin1(QTest::currentDataTag()))] = result;
+}
+
+inline bool writeJson(const QString& path, const QString& testCase, const QJsonObject& metadata, const QVector<Result>& results)
+{
+    QJsonArray array;
+    foreach (const Result& result, results) {
+        QJsonObject object;
+        object[QStringLiteral("function")] = result.function;
+        object[QStringLiteral("tag")] = result.tag;
+        object[QStringLiteral("metric")] = result.metric;
+        object[QStringLiteral("value")] = result.value;
+        object[QStringLiteral("iterations")] = result.iterations;
+        const auto it = BenchStats::summaries().constFind(BenchStats::summaryKey(result.function, result.tag));
+        if (it != BenchStats::summaries().constEnd()) {
+            QJsonObject stats;
+            stats[QStringLiteral("mean")] = it->mean;
+            stats[QStringLiteral("median")] = it->median;
+            stats[QStringLiteral("stddev")] = it->stddev;
+            stats[QStringLiteral("ciLow")] = it->ciLow;
+            stats[QStringLiteral("ciHigh")] = it->ciHigh;
+            stats[QStringLiteral("outliers")] = it->outliers;
+            QJsonArray samples;
+            for (double sample : it->samples) {
+                samples.append(sample);
+            }
+            stats[QStringLiteral("samples")] = samples;
+            object[QStringLiteral("stats")] = stats;
+        }
+        const auto perf = perfCounterResults().constFind(BenchStats::summaryKey(result.function, result.tag));
+        if (perf != perfCounterResults().constEnd()) {
+            object[QStringLiteral("perf")] = *perf;
+        }
+        array.append(object);
+    }
+    QJsonObject root;
+    root[QStringLiteral("testCase")] = testCase;
+    root[QStringLiteral("metadata")] = metadata;
+    root[QStringLiteral("results")] = array;
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning("failed to write %s: %s", qPrintable(path), qPrintable(file.errorString()));
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson());
+    return true;
+}
+
+inline QString csvField(QString field)
+{
+    if (field.contains(QLatin1Char(',')) || field.contains(QLatin1Char('"'))) {
+        field.replace(QLatin1Char('"'), QLatin1String("\"\""));
+        field = QLatin1Char('"') + field + QLatin1Char('"');
+    }
+    return field;
+}
+
+inline bool writeCsv(const QString& path, const QString& testCase, const QJsonObject& metadata, const QVector<Result>& results)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning("failed to write %s: %s", qPrintable(path), qPrintable(file.errorString()));
+        return false;
+    }
+    QTextStream stream(&file);
+    for (auto it = metadata.begin(); it != metadata.end(); ++it) {
+        stream << "# " << it.key() << ": " << it.value().toVariant().toString() << '\n';
+    }
+    stream << "testCase,function,tag,metric,value,iterations,mean,median,stddev,ciLow,ciHigh,outliers\n";
+    foreach (const Result& result, results) {
+        stream << csvField(testCase) << ',' << csvField(result.function) << ',' << csvField(result.tag) << ','
+               << result.metric << ',' << QString::number(result.value, 'g', 10) << ',' << result.iterations;
+        const auto it = BenchStats::summaries().constFind(BenchStats::summaryKey(result.function, result.tag));
+        if (it != BenchStats::summaries().constEnd()) {
+            for (double value : {it->mean, it->median, it->stddev, it->ciLow, it->ciHigh}) {
+                stream << ',' << QString::number(value, 'g', 10);
+            }
+            stream << ',' << it->outliers;
+        } else {
+            stream << ",,,,,,";
+        }
+        stream << '\n';
+    }
+    return true;
+}
+
+/**
+ * Like QTest::qExec, but additionally writes the results to
+ * BENCH_QT_REPORT_DIR if that environment variable is set.
+ */
+inline int exec(QObject* testObject, int argc, char** argv)
+{
+    const QString reportDir = QString::fromLocal8Bit(qgetenv("BENCH_QT_REPORT_DIR"));
+    if (reportDir.isEmpty()) {
+        return QTest::qExec(testObject, argc, argv);
+    }
+
+    QTemporaryFile xmlLog;
+    if (!xmlLog.open()) {
+        qWarning("failed to create temporary file for benchmark results");
+        return QTest::qExec(testObject, argc, argv);
+    }
+
+    QStringList arguments;
+    bool hasOutput = false;
+    for (int i = 0; i < argc; ++i) {
+        const QString argument = QString::fromLocal8Bit(argv[i]);
+        hasOutput |= argument == QLatin1String("-o");
+        arguments << argument;
+    }
+    if (!hasOutput) {
+        // keep the usual text output on stdout
+        arguments << QStringLiteral("-o") << QStringLiteral("-,txt");
+    }
+    arguments << QStringLiteral("-o") << (xmlLog.fileName() + QLatin1String(",xml"));
+
+    const int ret = QTest::qExec(testObject, arguments);
+    // reopen to read what QTestLib wrote through its own handle
+    xmlLog.close();
+    xmlLog.open();
+
+    const QString testCase = QString::fromLatin1(testObject->metaObject()->className());
+    const QVector<Result> results = parseXml(&xmlLog);
+    const QJsonObject info = metadata();
+    QDir().mkpath(reportDir);
+    const QString basePath = QDir(reportDir).filePath(testCase);
+    writeJson(basePath + QLatin1String(".json"), testCase, info, results);
+    writeCsv(basePath + QLatin1String(".csv"), testCase, info, results);
+    return ret;
+}
+
+}
+
+/*
+ * Like the QBENCHMARK macros of QTestLib, but the hardware counters of the
+ * benchmark cover the iterations of the block, see startPerfCounters(). The
+ * counters are started before and stopped after the timed iterations.
+ */
+#undef QBENCHMARK
+#define QBENCHMARK \
+    for (PerfCounterScope __perf_counters; __perf_counters.once();) \
+        for (QTest::QBenchmarkIterationController __iteration_controller; \
+             __iteration_controller.isDone() == false || (__perf_counters.addIterations(__iteration_controller.i), false); \
+             __iteration_controller.next())
+
+#undef QBENCHMARK_ONCE
+#define QBENCHMARK_ONCE \
+    for (PerfCounterScope __perf_counters; __perf_counters.once();) \
+        for (QTest::QBenchmarkIterationController __iteration_controller(QTest::QBenchmarkIterationController::RunOnce); \
+             __iteration_controller.isDone() == false || (__perf_counters.addIterations(__iteration_controller.i), false); \
+             __iteration_controller.next())
+
+#ifdef QT_WIDGETS_LIB
+#define BENCH_QT_MAIN(TestObject) \
+int main(int argc, char** argv) \
+{ \
+    QApplication app(argc, argv); \
+    app.setAttribute(Qt::AA_Use96Dpi, true); \
+    TestObject tc; \
+    return BenchReport::exec(&tc, argc, argv); \
+}
+#endif
+
+#define BENCH_QT_GUILESS_MAIN(TestObject) \
+int main(int argc, char** argv) \
+{ \
+    QCoreApplication app(argc, argv); \
+    TestObject tc; \
+    return BenchReport::exec(&tc, argc, argv); \
+}
+
+#endif
@@ -0,0 +1,264 @@
+/**
+ *
+ * Copyright (C) 2015 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com, author Milian Wolff <milian.wolff@kdab.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef BENCH_QT_STATS_H
+#define BENCH_QT_STATS_H
+
+#include <QtTest>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QVector>
+
+#include <algorithm>
+#include <cmath>
+
+#include "util.h"
+
+/**
+ * A more rigorous alternative to QBENCHMARK.
+ *
+ * QBENCHMARK only reports the median of its runs and times everything inside
+ * of its block. BenchStats::measure instead runs a couple of untimed warmup
+ * samples, then takes repeated samples where only the body is timed while the
+ * setup and teardown are not. Outliers are rejected based on the median
+ * absolute deviation and the remaining samples are summarized with mean,
+ * median, standard deviation and a 95% confidence interval for the mean.
+ *
+ * The number of samples can be changed with the BENCH_QT_WARMUP and
+ * BENCH_QT_SAMPLES environment variables.
+ */
+namespace BenchStats {
+
+struct Summary
+{
+    // the samples that were kept, in nanoseconds per operation or bytes per second, see reportThroughput()
+    QVector<double> samples;
+    int outliers = 0;
+    double mean = 0;
+    double median = 0;
+    double stddev = 0;
+    double ciLow = 0;
+    double ciHigh = 0;
+};
+
+inline int envValue(const char* name, int defaultValue)
+{
+    bool ok = false;
+    const int value = qEnvironmentVariableIntValue(name, &ok);
+    return ok && value > 0 ? value : defaultValue;
+}
+
+inline int warmupSamples()
+{
+    return envValue("BENCH_QT_WARMUP", 3);
+}
+
+inline int numSamples()
+{
+    return envValue("BENCH_QT_SAMPLES", 31);
+}
+
+// expects @p values to be sorted
+inline double sortedMedian(const QVector<double>& values)
+{
+    const int size = values.size();
+    if (!size) {
+        return 0;
+    }
+    return size % 2 ? values[size / 2] : (values[size / 2 - 1] + values[size / 2]) / 2;
+}
+
+// the 97.5% quantile of Student's t-distribution with @p df degrees of freedom
+inline double tQuantile975(int df)
+{
+    static const double TABLE[] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+    };
+    if (df < 1) {
+        return 0;
+    } else if (df <= 30) {
+        return TABLE[df - 1];
+    }
+    // first terms of the Cornish-Fisher expansion around the normal quantile
+    const double z = 1.959964;
+    return z + (z * z * z + z) / (4 * df);
+}
+
+/**
+ * Reject outliers from @p values and summarize the rest.
+ *
+ * A value counts as outlier when its modified z-score, i.e. its distance to
+ * the median in units of the median absolute deviation, exceeds 3.5.
+ */
+inline Summary summarize(QVector<double> values)
+{
+    Summary summary;
+    if (values.isEmpty()) {
+        return summary;
+    }
+    std::sort(values.begin(), values.end());
+    const double median = sortedMedian(values);
+
+    QVector<double> deviations;
+    deviations.reserve(values.size());
+    for (double value : values) {
+        deviations << std::fabs(value - median);
+    }
+    std::sort(deviations.begin(), deviations.end());
+    const double mad = sortedMedian(deviations);
+
+    for (double value : values) {
+        if (mad > 0 && 0.6745 * std::fabs(value - median) / mad > 3.5) {
+            ++summary.outliers;
+        } else {
+            summary.samples << value;
+        }
+    }
+
+    const int size = summary.samples.size();
+    double sum = 0;
+    for (double value : summary.samples) {
+        sum += value;
+    }
+    summary.mean = sum / size;
+    summary.median = sortedMedian(summary.samples);
+    if (size > 1) {
+        double squares = 0;
+        for (double value : summary.samples) {
+            squares += (value - summary.mean) * (value - summary.mean);
+        }
+        summary.stddev = std::sqrt(squares / (size - 1));
+    }
+    const double margin = tQuantile975(size - 1) * summary.stddev / std::sqrt(size);
+    summary.ciLow = summary.mean - margin;
+    summary.ciHigh = summary.mean + margin;
+    return summary;
+}
+
+// the summaries of the current process, by test function and data tag
+inline QHash<QString, Summary>& summaries()
+{
+    static QHash<QString, Summary> summaries;
+    return summaries;
+}
+
+inline QString summaryKey(const QString& function, const QString& tag)
+{
+    return function + QLatin1Char('/') + tag;
+}
+
+/**
+ * Measure @p body, which runs @p operations operations, e.g. allocations.
+ *
+ * For every sample, @p setup runs before and @p teardown after @p body,
+ * neither of them is included in the measurement. The hardware counters of
+ * the benchmark only cover the timed samples, per operation.
+ *
+ * @return the summary of the samples in nanoseconds per operation
+ */
+template<typename Setup, typename Body, typename Teardown>
+Summary measure(qint64 operations, Setup setup, Body body, Teardown teardown)
+{
+    const int warmup = warmupSamples();
+    for (int i = 0; i < warmup; ++i) {
+        setup();
+        body();
+        teardown();
+    }
+
+    const int count = numSamples();
+    QVector<double> values;
+    values.reserve(count);
+    QElapsedTimer timer;
+    for (int i = 0; i < count; ++i) {
+        setup();
+        {
+            PerfCounterScope counters;
+            timer.start();
+            body();
+            values << static_cast<double>(timer.nsecsElapsed()) / operations;
+            counters.addIterations(operations);
+        }
+        teardown();
+    }
+    return summarize(values);
+}
+
+template<typename Body>
+Summary measure(qint64 operations, Body body)
+{
+    return measure(operations, [] {}, body, [] {});
+}
+
+/**
+ * Report the median of @p summary as result of the current benchmark, and
+ * print the remaining statistics.
+ *
+ * The summary is also remembered for the JSON export, see report.h.
+ */
+inline void report(const Summary& summary)
+{
+    qDebug("mean %.3f ns, 95%% CI [%.3f, %.3f], median %.3f ns, stddev %.3f ns, %d/%d outliers rejected",
+           summary.mean, summary.ciLow, summary.ciHigh, summary.median, summary.stddev,
+           summary.outliers, summary.outliers + summary.samples.size());
+    summaries()[summaryKey(QString::fromLatin1(QTest::currentTestFunction()),
+                           QString::fromLatin1(QTest::currentDataTag()))] = summary;
+    QTest::setBenchmarkResult(summary.median, QTest::WalltimeNanoseconds);
+}
+
+/**
+ * Like report(), but for a @p summary measured in nanoseconds per byte, which
+ * gets reported as throughput in bytes per second instead.
+ */
+inline void reportThroughput(const Summary& summary)
+{
+    QVector<double> values;
+    values.reserve(summary.samples.size());
+    for (double nsPerByte : summary.samples) {
+        values << 1E9 / nsPerByte;
+    }
+    Summary throughput = summarize(values);
+    throughput.outliers += summary.outliers;
+    qDebug("mean %.2f MB/s, 95%% CI [%.2f, %.2f], median %.2f MB/s, stddev %.2f MB/s, %d/%d outliers rejected",
+           throughput.mean / 1E6, throughput.ciLow / 1E6, throughput.ciHigh / 1E6, throughput.median / 1E6,
+           throughput.stddev / 1E6, throughput.outliers, throughput.outliers + throughput.samples.size());
+    summaries()[summaryKey(QString::fromLatin1(QTest::currentTestFunction()),
+                           QString::fromLatin1(QTest::currentDataTag()))] = throughput;
+    QTest::setBenchmarkResult(throughput.median, QTest::BytesPerSecond);
+}
+
+}
+
+#endif
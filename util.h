@@ -34,6 +34,24 @@
 #define BENCH_QT_UTIL_H
 
 #include <qcompilerdetection.h>
+#include <QVector>
+#include <QElapsedTimer>
+#include <QString>
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+#ifdef Q_OS_LINUX
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
 
 #if defined(Q_CC_GNU) || defined(Q_CC_CLANG)
 // source: https://www.youtube.com/watch?v=nXaxk27zwlk
@@ -55,4 +73,339 @@ inline void clobber()
 static_assert(false, "escape and clobber not yet implemented for this compiler");
 #endif
 
+// 1, 2, 4, ... up to and including the number of hardware threads
+inline QVector<int> threadCounts()
+{
+    const int maxThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    QVector<int> counts;
+    for (int threads = 1; threads < maxThreads; threads *= 2) {
+        counts << threads;
+    }
+    counts << maxThreads;
+    return counts;
+}
+
+/**
+ * Hardware performance counters, counting between start() and stop() in user
+ * space of the calling thread and all threads it starts after construction.
+ * The counts of all start() and stop() pairs add up.
+ *
+ * This uses perf_event_open on Linux. Events which the CPU does not support or
+ * which we are not allowed to count, e.g. due to perf_event_paranoid or in a
+ * container, are not available. On other platforms no event is available.
+ */
+class PerfCounters
+{
+public:
+    enum Event
+    {
+        Cycles,
+        Instructions,
+        CacheMisses,
+        BranchMisses,
+        DTlbMisses,
+        NUM_EVENTS
+    };
+
+    PerfCounters()
+    {
+#ifdef Q_OS_LINUX
+        for (int event = 0; event < NUM_EVENTS; ++event) {
+            m_fds[event] = openEvent(static_cast<Event>(event));
+        }
+#endif
+    }
+
+    ~PerfCounters()
+    {
+        stop();
+#ifdef Q_OS_LINUX
+        for (int fd : m_fds) {
+            if (fd != -1) {
+                close(fd);
+            }
+        }
+#endif
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    void start()
+    {
+#ifdef Q_OS_LINUX
+        if (m_running) {
+            return;
+        }
+        m_running = true;
+        for (int fd : m_fds) {
+            if (fd != -1) {
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+#endif
+    }
+
+    // pause counting and read the counts so far
+    void stop()
+    {
+#ifdef Q_OS_LINUX
+        if (!m_running) {
+            return;
+        }
+        m_running = false;
+        for (int fd : m_fds) {
+            if (fd != -1) {
+                ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            }
+        }
+        for (int event = 0; event < NUM_EVENTS; ++event) {
+            // value, time enabled, time running
+            quint64 data[3] = {0, 0, 0};
+            if (m_fds[event] == -1 || read(m_fds[event], data, sizeof(data)) != sizeof(data) || !data[2]) {
+                continue;
+            }
+            // scale up when the kernel had to multiplex the hardware counters
+            m_values[event] = data[2] < data[1] ? static_cast<quint64>(double(data[0]) * data[1] / data[2]) : data[0];
+            m_available[event] = true;
+        }
+#endif
+    }
+
+    bool isRunning() const
+    {
+#ifdef Q_OS_LINUX
+        return m_running;
+#else
+        return false;
+#endif
+    }
+
+    // the number of runs of the benchmark body that were counted, see PerfCounterScope
+    qint64 iterations() const
+    {
+        return m_iterations;
+    }
+
+    void addIterations(qint64 iterations)
+    {
+        m_iterations += iterations;
+    }
+
+    // the counters which PerfCounterScope counts into, if any
+    static PerfCounters*& active()
+    {
+        static PerfCounters* counters = nullptr;
+        return counters;
+    }
+
+    bool isAvailable(Event event) const
+    {
+        return m_available[event];
+    }
+
+    bool isAvailable() const
+    {
+        return std::find(std::begin(m_available), std::end(m_available), true) != std::end(m_available);
+    }
+
+    quint64 value(Event event) const
+    {
+        return m_values[event];
+    }
+
+    double perIteration(Event event) const
+    {
+        return m_iterations ? static_cast<double>(m_values[event]) / m_iterations : 0;
+    }
+
+    // the reason why no event is available
+    QString error() const
+    {
+#ifdef Q_OS_LINUX
+        return QString::fromLocal8Bit(strerror(m_errno));
+#else
+        return QStringLiteral("not supported on this platform");
+#endif
+    }
+
+    static const char* eventName(Event event)
+    {
+        switch (event) {
+        case Cycles:
+            return "cycles";
+        case Instructions:
+            return "instructions";
+        case CacheMisses:
+            return "cacheMisses";
+        case BranchMisses:
+            return "branchMisses";
+        case DTlbMisses:
+            return "dTlbMisses";
+        case NUM_EVENTS:
+            break;
+        }
+        return "unknown";
+    }
+
+    // the counts per iteration, e.g. "cycles: 10.00, instructions: 20.00 (2.00 IPC), cacheMisses: 0.10 (5.00 per 1k instructions)"
+    QString summary() const
+    {
+        QString summary;
+        for (int i = 0; i < NUM_EVENTS; ++i) {
+            const auto event = static_cast<Event>(i);
+            if (!isAvailable(event)) {
+                continue;
+            }
+            if (!summary.isEmpty()) {
+                summary += QLatin1String(", ");
+            }
+            summary += QStringLiteral("%1: %2").arg(QLatin1String(eventName(event))).arg(perIteration(event), 0, 'f', 2);
+            if (event == Instructions && isAvailable(Cycles) && value(Cycles)) {
+                summary += QStringLiteral(" (%1 IPC)").arg(double(value(Instructions)) / value(Cycles), 0, 'f', 2);
+            } else if (event > Instructions && isAvailable(Instructions) && value(Instructions)) {
+                summary += QStringLiteral(" (%1 per 1k instructions)").arg(1000. * value(event) / value(Instructions), 0, 'f', 2);
+            }
+        }
+        return summary;
+    }
+
+private:
+#ifdef Q_OS_LINUX
+    int openEvent(Event event)
+    {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        switch (event) {
+        case Cycles:
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case Instructions:
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case CacheMisses:
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            break;
+        case BranchMisses:
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+        case DTlbMisses:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                        | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        case NUM_EVENTS:
+            return -1;
+        }
+        attr.disabled = 1;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        const int fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+        if (fd == -1) {
+            m_errno = errno;
+        }
+        return fd;
+    }
+
+    int m_fds[NUM_EVENTS];
+    int m_errno = 0;
+    bool m_running = false;
+#endif
+    quint64 m_values[NUM_EVENTS] = {};
+    bool m_available[NUM_EVENTS] = {};
+    qint64 m_iterations = 0;
+};
+
+/**
+ * Counts the hardware events of a benchmark body into PerfCounters::active()
+ * during its lifetime, see BenchReport::startPerfCounters(). Without active
+ * counters, or within another scope, this does nothing.
+ *
+ * Create it outside of the timed region, starting and stopping the counters
+ * takes a couple of system calls.
+ */
+class PerfCounterScope
+{
+public:
+    PerfCounterScope()
+        : m_counters(PerfCounters::active() && !PerfCounters::active()->isRunning() ? PerfCounters::active() : nullptr)
+    {
+        if (m_counters) {
+            m_counters->start();
+        }
+    }
+
+    ~PerfCounterScope()
+    {
+        if (m_counters) {
+            m_counters->stop();
+        }
+    }
+
+    PerfCounterScope(const PerfCounterScope&) = delete;
+    PerfCounterScope& operator=(const PerfCounterScope&) = delete;
+
+    // the scope covered @p iterations runs of the benchmark body
+    void addIterations(qint64 iterations)
+    {
+        if (m_counters) {
+            m_counters->addIterations(iterations);
+        }
+    }
+
+    // true on the first call only, to run a loop body once within the scope, see QBENCHMARK in report.h
+    bool once()
+    {
+        const bool first = !m_done;
+        m_done = true;
+        return first;
+    }
+
+private:
+    PerfCounters* m_counters;
+    bool m_done = false;
+};
+
+/**
+ * Run @p func(thread) on @p numThreads threads which all start at the same time.
+ *
+ * The hardware counters of the benchmark cover all of @p func, as one iteration.
+ *
+ * @return the wall time in nanoseconds until all threads have finished
+ */
+template<typename Func>
+qint64 runThreads(int numThreads, Func func)
+{
+    std::atomic<int> ready(0);
+    std::atomic<bool> go(false);
+    std::vector<std::thread> threads;
+    threads.reserve(numThreads);
+    for (int t = 0; t < numThreads; ++t) {
+        threads.emplace_back([&, t] {
+            ++ready;
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            func(t);
+        });
+    }
+
+    while (ready.load() != numThreads) {
+        std::this_thread::yield();
+    }
+    PerfCounterScope counters;
+    QElapsedTimer timer;
+    timer.start();
+    go.store(true, std::memory_order_release);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    counters.addIterations(1);
+    return timer.nsecsElapsed();
+}
+
 #endif
\ No newline at end of file